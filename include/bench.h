@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "metal.h"
+
+#ifdef BENCH_ENABLED
+extern const word_table_t bench_words;  // Benchmark words
+#endif
+
+#endif  // BENCH_H
@@ -0,0 +1,32 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cell.h"
+#include "metal.h"
+
+// Arbitrary-precision integers. The integer operations below accept any mix
+// of int32, int64 and bigint cells and return the smallest cell that holds
+// the result, so a bigint is only ever allocated for values beyond int64.
+
+// Bigint data management
+bigint_data_t* create_bigint_data(size_t length);
+
+// Arithmetic (divisors must be nonzero; quotients truncate toward zero)
+cell_t bigint_add(const cell_t* a, const cell_t* b);
+cell_t bigint_subtract(const cell_t* a, const cell_t* b);
+cell_t bigint_multiply(const cell_t* a, const cell_t* b);
+cell_t bigint_divide(const cell_t* a, const cell_t* b);
+cell_t bigint_mod(const cell_t* a, const cell_t* b);
+
+// Comparison: negative, zero or positive as a <, = or > b
+int bigint_compare(const cell_t* a, const cell_t* b);
+
+// Conversions
+double bigint_to_float(const bigint_data_t* data);
+char* bigint_to_string(const bigint_data_t* data);  // Caller frees
+bool parse_bigint(const char* digits, cell_t* result);
+
+#endif  // BIGINT_H
@@ -1,6 +1,7 @@
 #ifndef CELL_H
 #define CELL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Forward declaration for circular dependency
@@ -12,6 +13,9 @@ typedef enum : uint8_t {
   CELL_INT32,
   CELL_INT64,
   CELL_FLOAT,
+  CELL_FLOAT32,
+  CELL_FIXED,
+  CELL_BIGINT,
   CELL_STRING,
   CELL_INTERNED,
   CELL_OBJECT,
@@ -38,6 +42,7 @@ typedef enum : uint8_t {
   CELL_FLAG_IMMUTABLE = 1 << 1,   // 0x0002
   CELL_FLAG_WEAK_REF = 1 << 2,    // 0x0004
   CELL_FLAG_TEMPORARY = 1 << 3,   // 0x0008
+  CELL_FLAG_TAIL_CALL = 1 << 4,   // 0x0010 - compiled call reuses the frame
 } cell_flags_t;
 
 typedef void (*native_func_t)(context_t* context);
@@ -56,6 +61,8 @@ typedef struct cell {
     int32_t i32;           // 32-bit integer
     int64_t i64;           // 64-bit integer
     double f;              // Double precision float
+    float f32;             // Single precision float
+    int32_t fixed;         // Q16.16 fixed point
     void* ptr;             // Pointer to allocated cell
     native_func_t native;  // Function pointer
     struct cell* pointer;  // Code pointer (using struct tag to avoid issues)
@@ -85,7 +92,10 @@ typedef struct cell {
 cell_t new_int32(int32_t value);
 cell_t new_int64(int64_t value);
 cell_t new_float(double value);
+cell_t new_float32(float value);
+cell_t new_fixed(int32_t raw);
 cell_t new_string(const char* utf8);
+cell_t new_string_span(const char* utf8, size_t length);
 cell_t new_empty(void);
 cell_t new_nil(void);
 cell_t new_pointer(cell_t* target);
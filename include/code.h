@@ -0,0 +1,29 @@
+#ifndef CODE_H
+#define CODE_H
+
+#include <stddef.h>
+
+#include "cell.h"
+#include "metal.h"
+
+// Code data management
+code_data_t* create_code_data(size_t length);
+
+// Cell creation for code
+cell_t new_code(code_data_t* data);
+
+// Inner interpreter - runs a native or compiled definition to completion on
+// the selected engine
+void execute(context_t* ctx, const cell_t* definition);
+void execute_threaded(context_t* ctx, code_data_t* code);
+
+// Test a cell as a condition (0, NIL, NULL and EMPTY are false)
+bool is_true(const cell_t* cell);
+bool pop_flag(context_t* ctx);
+
+// Threaded code primitives (compiled by the compiler, never looked up)
+void native_exit(context_t* ctx);     // EXIT ( -- ) Return from definition
+void native_branch(context_t* ctx);   // (BRANCH) ( -- ) Jump by inline offset
+void native_zbranch(context_t* ctx);  // (0BRANCH) ( flag -- ) Jump if false
+
+#endif  // CODE_H
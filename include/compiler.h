@@ -0,0 +1,20 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "metal.h"
+
+// Compilation state
+bool is_compiling(void);
+void abort_compilation(void);
+
+// Append to the definition being compiled
+void compile_literal(cell_t cell);  // Takes over the caller's reference
+void compile_word(const dictionary_entry_t* entry);
+
+// Times a redefinition has rebuilt existing definitions
+uint32_t get_relink_count(void);
+
+// Compiler words (: ; IF ELSE THEN ...) for the dictionary
+extern const word_table_t compiler_words;
+
+#endif  // COMPILER_H
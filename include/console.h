@@ -0,0 +1,10 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stddef.h>
+
+// Write a block of output to the console in as few transfers as the
+// platform allows (platform-specific, see platform/*/src)
+void console_write(const char* data, size_t length);
+
+#endif  // CONSOLE_H
@@ -1,7 +1,21 @@
 #ifndef CORE_H
 #define CORE_H
 
-// Add core language words to the dictionary
-void add_core_words(void);
+#include "metal.h"
 
-#endif  // CORE_H
\ No newline at end of file
+// Core language words for the dictionary
+extern const word_table_t core_words;
+
+// Core primitives (exported so metal2c output can call them directly)
+void native_dup(context_t* ctx);     // DUP ( a -- a a )
+void native_drop(context_t* ctx);    // DROP ( a -- )
+void native_swap(context_t* ctx);    // SWAP ( a b -- b a )
+void native_print(context_t* ctx);   // PRINT ( a -- )
+void native_nil(context_t* ctx);     // [] ( -- array )
+void native_comma(context_t* ctx);   // , ( array item -- array )
+void native_length(context_t* ctx);  // LENGTH ( array -- n )
+void native_index(context_t* ctx);   // INDEX ( array n -- ptr )
+void native_fetch(context_t* ctx);   // @ ( ptr -- value )
+void native_store(context_t* ctx);   // ! ( ptr value -- )
+
+#endif  // CORE_H
@@ -3,13 +3,73 @@
 
 #include "metal.h"
 
-// Dictionary management
-void init_dictionary(void);
-void add_native_word(const char* name, native_func_t func, const char* help);
-dictionary_entry_t* find_word(const char* name);
+// Tree-shaken builds (metal --metal2c ... --entry WORD) name a generated
+// keep header here. A built-in word the entry cannot reach is left without
+// a native or help text, so neither is linked in.
+#ifdef METAL_KEEP_WORDS
+#include METAL_KEEP_WORDS
+#define KEPT_WORD(name, value) (metal_keeps_word(name) ? (value) : nullptr)
+#define KEPT_HELP(help) nullptr
+#else
+#define KEPT_WORD(name, value) (value)
+#define KEPT_HELP(help) (help)
+#endif
+
+// Built-in words are initializers for a module's const table
+#define WORDLIST_WORD(word, func, text, word_flags, list)                  \
+  {.name = (word),                                                         \
+   .definition = {.type = CELL_NATIVE,                                     \
+                  .payload.native = KEPT_WORD(word, func)},                \
+   .help = KEPT_HELP(text),                                                \
+   .flags = (word_flags),                                                  \
+   .wordlist = (list)}
+#define BUILTIN_WORD(word, func, text, word_flags) \
+  WORDLIST_WORD(word, func, text, word_flags, FORTH_WORDLIST)
+#define NATIVE_WORD(name, func, help) \
+  BUILTIN_WORD(name, func, help, WORD_FLAG_NONE)
+#define IMMEDIATE_WORD(name, func, help) \
+  BUILTIN_WORD(name, func, help, WORD_FLAG_IMMEDIATE)
+#define DEFINING_WORD(name, func, help) \
+  BUILTIN_WORD(name, func, help, WORD_FLAG_DEFINING)
+#define WORD_TABLE(entries) {(entries), sizeof(entries) / sizeof((entries)[0])}
+
+// Dictionary management. The built-in tables come first, later ones
+// shadowing earlier ones, and are never copied.
+void init_dictionary(const word_table_t* const* tables, int table_count);
+void add_code_word(const char* name, cell_t code, const char* help);
+const dictionary_entry_t* find_word(const char* name);
+const dictionary_entry_t* find_word_span(const char* name, size_t length);
+const dictionary_entry_t* find_current_word(const char* name);
+void forget_words(int size);  // Drop the newest entries back to size
+
+// Wordlists. Lookups search the wordlists of the search order first to
+// last, then FORTH if the order left it out, and new words go into the
+// current wordlist. FORTH holds the built-ins; any other wordlist belongs to
+// the entry (flagged WORD_FLAG_VOCABULARY) that selects it and goes when
+// that is forgotten.
+#define FORTH_WORDLIST 0
+#define MAX_WORDLISTS 16
+#define MAX_SEARCH_ORDER 8
+int create_wordlist(int owner);  // -1 when there is no room
+int get_wordlist_count(void);
+const char* get_wordlist_name(int wordlist);
+int get_current_wordlist(void);
+void set_current_wordlist(int wordlist);
+int get_search_order(int* order);  // Returns the depth
+void set_search_order(const int* order, int depth);
+
+// Dependency tracking. An entry takes over its links array (from
+// metal_alloc) and becomes a dependent of every word it links to.
+int get_entry_index(const dictionary_entry_t* entry);
+void set_word_links(int index, link_site_t* links, uint32_t count);
+void add_dependent(int index, int dependent);
+void remove_dependent(int index, int dependent);
+const int* get_dependents(int index, uint32_t* count);
 
 // Dictionary introspection (for tools)
 int get_dictionary_size(void);
-dictionary_entry_t* get_dictionary_entry(int index);
+const dictionary_entry_t* get_dictionary_entry(int index);
+dictionary_entry_t* get_defined_entry(int index);  // NULL for built-ins
+const char* find_word_name(const cell_t* definition);
 
-#endif  // DICTIONARY_H
\ No newline at end of file
+#endif  // DICTIONARY_H
@@ -0,0 +1,40 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include "metal.h"
+
+// Epoch-based reclamation, so other contexts can read the dictionary and
+// run compiled code without locks while the updating context (the REPL)
+// changes it. Each reader context brackets its work with epoch_enter and
+// epoch_exit; the updater publishes new versions, retires what they replace
+// instead of freeing it, and reclaims once every reader that could still
+// see it has been quiescent. The updater is not a reader itself: it only
+// reclaims at its own quiescent points, between top-level lines.
+//
+// This covers looking words up and reading their entries. Running shared
+// code from another context is not safe yet: reference counts are plain
+// increments and decrements, and quickening rewrites instructions in place
+// with ordinary stores, so only one context may retain, release or execute
+// cells at a time.
+
+// Reader slots, registered and released by the updater
+int epoch_register(void);  // -1 when every slot is taken
+void epoch_unregister(int slot);
+
+// A reader's critical section; these nest
+void epoch_enter(int slot);
+void epoch_exit(int slot);
+
+// Updater only. Free or release once no reader can still reach it.
+void epoch_retire(void* ptr);
+void epoch_retire_cell(cell_t cell);
+void epoch_reclaim(void);
+
+// Updater only: wait until every reader has been quiescent, then reclaim
+void epoch_synchronize(void);
+
+#ifdef DEBUG_ENABLED
+extern const word_table_t epoch_words;  // EPOCH-CHECK
+#endif
+
+#endif  // EPOCH_H
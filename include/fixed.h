@@ -0,0 +1,39 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metal.h"
+
+// Q16.16 fixed point: a signed 32-bit value scaled by 2^16. Every operation
+// saturates at the ends of the range instead of wrapping. Q1.15 values are
+// exactly representable, so Q1.15 coefficients need no separate type.
+
+#define FIXED_FRACTION_BITS 16
+#define FIXED_ONE (1 << FIXED_FRACTION_BITS)
+
+// Conversions
+int32_t fixed_saturate(int64_t raw);
+int32_t fixed_from_int64(int64_t value);
+int32_t fixed_from_double(double value);
+double fixed_to_double(int32_t raw);
+
+// Saturating arithmetic on raw values (divisors must be nonzero)
+int32_t fixed_add(int32_t a, int32_t b);
+int32_t fixed_subtract(int32_t a, int32_t b);
+int32_t fixed_multiply(int32_t a, int32_t b);
+int32_t fixed_divide(int32_t a, int32_t b);
+
+// Kernels over packed Q16.16 buffers. Samples before the start of the input
+// count as zero for the FIR filter; the moving average of the first samples
+// covers only those seen so far.
+void fixed_fir(const int32_t* input, size_t length, const int32_t* taps,
+               size_t tap_count, int32_t* output);
+void fixed_moving_average(const int32_t* input, size_t length, size_t window,
+                          int32_t* output);
+
+// Fixed-point signal processing words for the dictionary
+extern const word_table_t fixed_words;
+
+#endif  // FIXED_H
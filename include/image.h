@@ -0,0 +1,23 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "image_file.h"
+#include "metal.h"
+
+// SAVE-IMAGE writes every word defined after the built-ins, with the code,
+// strings and bigints they reach, to a file laid out for mapping: pointers
+// are stored as file offsets and a relocation table lists them. Booting
+// from the image maps it and patches those slots in place, so nothing is
+// parsed or compiled.
+
+// Note the built-in words; call once they are all in the dictionary
+void init_image(void);
+
+// Map an image and add its words, returning NULL or the reason it failed.
+// The mapping must outlive the words.
+const char* load_image(const char* path, image_file_t* image);
+
+// SAVE-IMAGE, for the dictionary
+extern const word_table_t image_words;
+
+#endif  // IMAGE_H
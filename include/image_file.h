@@ -0,0 +1,17 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+
+#include <stddef.h>
+
+// A whole file mapped copy-on-write: pages are loaded on first use and
+// become private to the process when written (platform-specific, see
+// platform/*/src)
+typedef struct {
+  void* data;
+  size_t length;
+} image_file_t;
+
+bool map_image_file(const char* path, image_file_t* file);
+void unmap_image_file(image_file_t* file);
+
+#endif  // IMAGE_FILE_H
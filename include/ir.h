@@ -0,0 +1,58 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metal.h"
+
+// Register IR: compiled definitions lowered from stack operations to
+// operations on virtual registers. Values only reach the data stack where
+// a native word, a call or a block boundary needs them there.
+
+typedef cell_t (*binary_func_t)(const cell_t* a, const cell_t* b);
+
+typedef enum : uint8_t {
+  IR_LOAD,          // r[dst] = constant
+  IR_POP,           // r[dst] = pop data stack
+  IR_PUSH,          // push r[src1] (retained copy)
+  IR_PUSH_MOVE,     // push r[src1] (register gives up its reference)
+  IR_RELEASE,       // release r[src1]
+  IR_BINARY,        // r[dst] = binary(r[src1], r[src2])
+  IR_CALL_NATIVE,   // call native on the data stack
+  IR_CALL,          // call compiled code
+  IR_TAIL_CALL,     // replace this frame with compiled code
+  IR_JUMP,          // goto target
+  IR_JUMP_IF_FALSE, // release r[src1], goto target if it was false
+  IR_RETURN,        // return from definition
+} ir_opcode_t;
+
+typedef struct {
+  ir_opcode_t op;
+  uint8_t dst, src1, src2;
+  int32_t target;  // Instruction index for jumps
+  union {
+    cell_t constant;       // IR_LOAD (borrowed from the threaded code)
+    native_func_t native;  // IR_CALL_NATIVE
+    binary_func_t binary;  // IR_BINARY
+    code_data_t* code;     // IR_CALL, IR_TAIL_CALL
+  };
+} ir_instruction_t;
+
+struct ir_code {
+  size_t length;
+  uint16_t register_count;
+  ir_instruction_t instructions[];
+};
+
+// Engine selection (the stack engine is the default)
+extern bool register_engine_enabled;
+
+// Lowering and execution
+ir_code_t* ir_lower(const code_data_t* code);
+void ir_execute(context_t* ctx, code_data_t* code);
+
+// Register VM words for the dictionary
+extern const word_table_t ir_words;
+
+#endif  // IR_H
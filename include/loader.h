@@ -0,0 +1,18 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "metal.h"
+
+// Source files are loaded with INCLUDE. A file whose loading only adds
+// definitions is cached next to it (path + ".cache") as compiled code, keyed
+// by a hash of its content and of every word it uses from outside, and later
+// includes replay the cache instead of parsing and compiling again.
+
+// Interpret a whole source from inside a word, keeping the caller's parse
+// position and error handler
+bool interpret_nested(context_t* ctx, const char* source);
+
+// INCLUDE, for the dictionary
+extern const word_table_t loader_words;
+
+#endif  // LOADER_H
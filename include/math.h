@@ -0,0 +1,58 @@
+#ifndef MATH_H
+#define MATH_H
+
+#include <stdint.h>
+
+#include "metal.h"
+
+// Numeric tower: int32 -> int64 -> bigint -> fixed -> float32 -> float.
+// Operations dispatch on the pair of operand types, run in the later of the
+// two, and promote integers only when a result does not fit.
+
+// Arithmetic and comparison words for the dictionary
+extern const word_table_t math_words;
+
+// Arithmetic words (exported so metal2c output can call them directly)
+void native_add(context_t* ctx);            // + ( a b -- a+b )
+void native_subtract(context_t* ctx);       // - ( a b -- a-b )
+void native_multiply(context_t* ctx);       // * ( a b -- a*b )
+void native_divide(context_t* ctx);         // / ( a b -- a/b )
+void native_mod(context_t* ctx);            // MOD ( a b -- a%b )
+void native_less(context_t* ctx);           // < ( a b -- flag )
+void native_greater(context_t* ctx);        // > ( a b -- flag )
+void native_equal(context_t* ctx);          // = ( a b -- flag )
+void native_not_equal(context_t* ctx);      // <> ( a b -- flag )
+void native_less_equal(context_t* ctx);     // <= ( a b -- flag )
+void native_greater_equal(context_t* ctx);  // >= ( a b -- flag )
+
+// Operations on cells (shared by the words and the register VM)
+cell_t add_cells(const cell_t* a, const cell_t* b);
+cell_t subtract_cells(const cell_t* a, const cell_t* b);
+cell_t multiply_cells(const cell_t* a, const cell_t* b);
+cell_t divide_cells(const cell_t* a, const cell_t* b);
+cell_t mod_cells(const cell_t* a, const cell_t* b);
+cell_t less_cells(const cell_t* a, const cell_t* b);
+cell_t greater_cells(const cell_t* a, const cell_t* b);
+cell_t equal_cells(const cell_t* a, const cell_t* b);
+cell_t not_equal_cells(const cell_t* a, const cell_t* b);
+cell_t less_equal_cells(const cell_t* a, const cell_t* b);
+cell_t greater_equal_cells(const cell_t* a, const cell_t* b);
+
+// True for any cell the numeric tower accepts
+bool is_number(const cell_t* cell);
+
+// Saturating conversion of any number to raw Q16.16
+int32_t cell_to_fixed(const cell_t* cell);
+
+// Smallest integer cell that holds the value
+cell_t new_integer(int64_t value);
+
+// Comparison result: -1 for true, 0 for false
+cell_t new_flag(bool value);
+
+// Quickened variants of generic words (see math.c)
+native_func_t learning_variant(native_func_t generic);
+native_func_t generic_variant(native_func_t native);
+const char* variant_name(native_func_t native);
+
+#endif  // MATH_H
@@ -2,6 +2,9 @@
 #define MEMORY_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "metal.h"
 
 // Memory management initialization
 void init_memory(void);
@@ -11,4 +14,28 @@ void* metal_alloc(size_t size);
 void* metal_realloc(void* ptr, size_t new_size);
 void metal_free(void* ptr);
 
-#endif  // MEMORY_H
\ No newline at end of file
+#ifdef MEM_STATS_ENABLED
+// Allocation sizes by power of four: up to 16 bytes, 64, 256, 1K, 4K, 16K,
+// 64K, and larger
+#define MEM_SIZE_CLASSES 8
+
+// Heap counters since startup, in bytes requested (headers not included)
+typedef struct {
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t live_blocks;
+  uint64_t allocations;
+  uint64_t resizes;
+  uint64_t frees;
+  uint64_t by_size[MEM_SIZE_CLASSES];
+  uint64_t by_type[CELL_INT_PAIR + 1];  // Heap data created per cell type
+} mem_stats_t;
+
+void get_mem_stats(mem_stats_t* stats);
+void count_cell_alloc(cell_type_t type);  // Called by the cell creators
+extern const word_table_t memory_words;  // MEM-STATS
+#else
+#define count_cell_alloc(type) ((void)0)
+#endif
+
+#endif  // MEMORY_H
@@ -23,7 +23,7 @@ struct context {
   int return_stack_ptr;
 
   // Instruction pointer (for threaded code)
-  cell_t** ip;
+  cell_t* ip;
 
   // Error handling
   jmp_buf error_jmp;  // For longjmp on errors
@@ -46,19 +46,69 @@ typedef struct {
   cell_t elements[];  // Flexible array member
 } array_data_t;
 
+// Arbitrary-precision integer (see bigint.h)
+typedef struct {
+  size_t length;     // Limbs in use, most significant is nonzero
+  bool negative;     // Sign and magnitude
+  uint32_t limbs[];  // Magnitude, least significant first
+} bigint_data_t;
+
+// Register IR for compiled code (see ir.h)
+typedef struct ir_code ir_code_t;
+
+// Compiled code structure
+typedef struct {
+  size_t length;
+  ir_code_t* ir;          // Lowered on first run by the register VM
+  cell_t instructions[];  // Threaded code, terminated by EXIT
+} code_data_t;
+
 // Allocated data header (for refcounting)
 typedef struct {
   uint32_t refcount;
   // Actual data follows
 } alloc_header_t;
 
-// Dictionary entry
+// Dictionary entry flags
+typedef enum : uint8_t {
+  WORD_FLAG_NONE = 0,
+  WORD_FLAG_IMMEDIATE = 1 << 0,  // Executes even while compiling
+  WORD_FLAG_DEFINING = 1 << 1,   // Only adds definitions (see INCLUDE)
+  WORD_FLAG_VOCABULARY = 1 << 2,  // Owns the wordlist its code selects
+} word_flags_t;
+
+// A call to, or inlined copy of, another word inside compiled code
 typedef struct {
-  char name[32];      // Word name
+  uint32_t position;  // First cell
+  uint32_t length;    // 1 for a call
+  int entry;          // Dictionary index of the word
+} link_site_t;
+
+// Longest word name
+#define MAX_NAME_LENGTH 31
+
+// Dictionary entry. Built-in entries are const tables in flash; only words
+// defined at run time are in RAM.
+typedef struct {
+  const char* name;   // Word name
   cell_t definition;  // Code cell or other definition
   const char* help;   // Help text (stack effect + description)
+  word_flags_t flags;
+  uint8_t wordlist;  // Wordlist the word was defined into (0 is FORTH)
+  uint64_t hash;     // Identity of a definition for INCLUDE caches
+
+  // Words this definition's code links to, so redefining one of them can
+  // relink it (see set_word_links)
+  link_site_t* links;
+  uint32_t link_count;
 } dictionary_entry_t;
 
+// A module's built-in words, in definition order
+typedef struct {
+  const dictionary_entry_t* entries;
+  int count;
+} word_table_t;
+
 // Interpreter result codes
 typedef enum {
   METAL_OK,
@@ -70,8 +120,12 @@ typedef enum {
 
 // Core interpreter functions
 metal_result_t interpret(const char* input);
+
+// Top-level actions so far other than defining words; INCLUDE only caches a
+// file whose loading adds definitions and nothing else
+uint32_t top_level_effects(void);
 bool metal_input_complete(const char* input);
-void error(const char* fmt, ...);
+[[gnu::format(printf, 1, 2)]] void error(const char* fmt, ...);
 
 // Context management
 void init_context(context_t* ctx);
@@ -0,0 +1,19 @@
+#ifndef METAL2C_H
+#define METAL2C_H
+
+#include "metal.h"
+
+// Ahead-of-time translator: compile a Metal source file and write every
+// colon definition it creates as a C function. Given an entry word, only
+// what it can reach is translated, and a keep header (output stem +
+// "_keep.h") lets the build drop every other word. Returns a process exit
+// code.
+int metal2c(const char* input_path, const char* output_path,
+            const char* entry_word);
+
+// A translated unit, linked in when METAL_AOT is defined: its words, and
+// the setup of the natives and literals they use, run once at boot
+extern const word_table_t compiled_words;
+void init_compiled_words(void);
+
+#endif  // METAL2C_H
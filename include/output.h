@@ -0,0 +1,21 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metal.h"
+
+// Console output. Text collects in a buffer that goes to the console in one
+// write when it fills, after each line the interpreter runs, and on FLUSH.
+void output_char(char c);
+void output_text(const char* text);
+void output_span(const char* text, size_t length);
+void output_padded(const char* text, int width);  // Left-aligned
+void output_int(int64_t value);
+[[gnu::format(printf, 1, 2)]] void output_format(const char* format, ...);
+void output_flush(void);
+
+extern const word_table_t output_words;  // FLUSH
+
+#endif  // OUTPUT_H
@@ -6,12 +6,26 @@
 // Token types for lexical analysis
 typedef enum { TOKEN_WORD, TOKEN_STRING, TOKEN_EOF } token_type_t;
 
+// A token is a span of the source text, valid as long as the source is. The
+// span of a string literal excludes its quotes and is still escaped.
+typedef struct {
+  token_type_t type;
+  const char* start;
+  size_t length;
+  bool escaped;  // string literal contains backslash escapes
+} token_t;
+
 // Core parsing functions
-token_type_t parse_next_token(const char** input_pos, char* buffer,
-                              size_t buffer_size);
+token_type_t parse_next_token(const char** input_pos, token_t* token);
+cell_t token_string(const token_t* token);  // string literal as a cell
 void skip_whitespace(const char** input_pos);
 bool has_more_input(const char* input_pos);
 
+// Parse a numeric literal: integers (bigints when too large for int64),
+// decimals with optional exponent, and the f (float32) and q (Q16.16)
+// suffixes. Returns false without touching result for anything else.
+bool try_parse_number(const char* token, size_t length, cell_t* result);
+
 // Special parsing for words that need it
 char* parse_until_char(context_t* ctx, char delimiter);
 void skip_to_end_of_line(const char** input_pos);
@@ -0,0 +1,20 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "metal.h"
+
+// Per-word profiling. While enabled, the engines report each call of a
+// compiled word or native and each return, and every definition collects
+// its call count and inclusive and exclusive time. Natives the register VM
+// lowers to inline operations are not seen.
+extern bool profile_enabled;
+
+void profile_enter_code(code_data_t* code);
+void profile_enter_native(native_func_t native);
+void profile_exit(void);
+void profile_unwind(void);  // Drop calls an error returned from
+
+// PROFILE-ON, PROFILE-OFF and PROFILE-REPORT, for the dictionary
+extern const word_table_t profile_words;
+
+#endif  // PROFILE_H
@@ -0,0 +1,16 @@
+#ifndef SAMPLE_TIMER_H
+#define SAMPLE_TIMER_H
+
+#include <stdbool.h>
+
+// Whether this platform has such a timer, checked before anything is set
+// up for it
+bool sample_timer_available(void);
+
+// Calls tick from a signal handler hz times per second of CPU time used by
+// the process, for sampling profilers. False where there is no such timer
+// (platform-specific, see platform/*/src).
+bool start_sample_timer(int hz, void (*tick)(void));
+void stop_sample_timer(void);
+
+#endif  // SAMPLE_TIMER_H
@@ -0,0 +1,13 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "metal.h"
+
+// Sampling profiler. A CPU-time timer (see sample_timer.h) interrupts the
+// interpreter and the signal handler copies its instruction pointer and
+// return stack; SAMPLE-SAVE names the words behind them afterwards and
+// writes folded stacks ("outer;inner;leaf count" per line) for flame graph
+// tools.
+extern const word_table_t sampler_words;
+
+#endif  // SAMPLER_H
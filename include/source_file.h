@@ -0,0 +1,16 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include <stddef.h>
+
+// A whole source file, readable as one NUL-terminated string
+// (platform-specific, see platform/*/src)
+typedef struct {
+  const char* text;
+  size_t length;
+} source_file_t;
+
+bool open_source_file(const char* path, source_file_t* file);
+void close_source_file(source_file_t* file);
+
+#endif  // SOURCE_FILE_H
@@ -0,0 +1,9 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Monotonic clock in nanoseconds (platform-specific, see platform/*/src)
+uint64_t timer_ns(void);
+
+#endif  // TIMER_H
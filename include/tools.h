@@ -1,7 +1,9 @@
 #ifndef TOOLS_H
 #define TOOLS_H
 
-// Add development tool words to the dictionary
-void add_tools_words(void);
+#include "metal.h"
+
+// Development tool words for the dictionary
+extern const word_table_t tools_words;
 
 #endif  // TOOLS_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "metal.h"
+
+#ifdef DEBUG_ENABLED
+// Tracepoints. Each is a fixed-size event with a timestamp, a static event
+// ID and up to three integer arguments; the text is only formatted when the
+// trace is shown or decoded. Append new events at the end so saved traces
+// still decode.
+typedef enum {
+  TRACE_DATA_PUSH,            // cell type, depth
+  TRACE_DATA_POP,             // cell type, depth
+  TRACE_RETURN_PUSH,          // cell type, depth
+  TRACE_RETURN_POP,           // cell type, depth
+  TRACE_RETAIN,               // cell type, refcount
+  TRACE_RELEASE,              // cell type, refcount
+  TRACE_ALLOCATE,             // bytes
+  TRACE_ARRAY_CREATE,         // capacity
+  TRACE_ARRAY_CREATE_FAIL,    // capacity
+  TRACE_ARRAY_RESIZE,         // old capacity, new capacity
+  TRACE_ARRAY_RESIZE_FAIL,    // old capacity, new capacity
+  TRACE_BIGINT_CREATE_FAIL,   // limbs
+  TRACE_CODE_CREATE,          // length
+  TRACE_CODE_CREATE_FAIL,     // length
+  TRACE_COMPILE_START,        // index the word will get
+  TRACE_COMPILE_END,          // index, cells
+  TRACE_COMPILE_ABORT,        // cells so far
+  TRACE_INLINE,               // inlined word, cells
+  TRACE_RELINK,               // word, cells
+  TRACE_RELINK_DONE,          // definitions relinked, redefined word
+  TRACE_DICTIONARY_INIT,      // built-in words
+  TRACE_WORD_ADD,             // index
+  TRACE_WORD_FOUND,           // index
+  TRACE_WORD_MISSING,         // name length
+  TRACE_RECLAIM,              // reclaimed, retired
+  TRACE_IMAGE_LOAD,           // bytes
+  TRACE_LOWER,                // cells, IR instructions, registers
+  TRACE_INCLUDE_REPLAY,       // entries in the cache
+  TRACE_INCLUDE_COMPILE,      // cached
+  TRACE_PARSE_WORD,           // length
+  TRACE_PARSE_STRING,         // length
+  TRACE_PARSE_UNTERMINATED,
+  TRACE_PARSE_UNTIL,          // length
+  TRACE_PARSE_UNTIL_MISSING,  // delimiter
+  TRACE_PARSE_UNTIL_NO_INPUT,
+  TRACE_PARSE_UNTIL_NO_MEMORY,
+  TRACE_EVENT_COUNT,
+} trace_id_t;
+
+typedef struct {
+  uint64_t time_ns;
+  uint32_t id;  // trace_id_t
+  uint32_t args[3];
+} trace_event_t;
+
+// Ring of the most recent events. Only the running context writes to it,
+// so a write is a plain store and a release of the head.
+typedef struct {
+  _Atomic uint32_t head;  // Events written so far; wraps past the size
+  trace_event_t events[];
+} trace_ring_t;
+
+// Ring of the running context, or NULL while tracing is off
+extern trace_ring_t* trace_ring;
+
+void trace_write(trace_id_t id, const uint32_t args[3]);
+#define trace(id, ...)                                              \
+  do {                                                              \
+    if (trace_ring) trace_write((id), (uint32_t[3]){__VA_ARGS__}); \
+  } while (0)
+
+// metal --trace file: print a trace saved by TRACE-SAVE
+int decode_trace(const char* path);
+
+extern const word_table_t trace_words;  // TRACE-ON, TRACE-SAVE, ...
+#else
+#define trace(id, ...) ((void)0)
+#endif
+
+#endif  // TRACE_H
@@ -8,4 +8,11 @@ void print_cell(const cell_t* cell);
 
 int stricmp(const char* s1, const char* s2);
 
+// 64-bit FNV-1a, chained by passing the previous hash (start from FNV_OFFSET)
+#define FNV_OFFSET UINT64_C(0xcbf29ce484222325)
+uint64_t fnv1a(const void* data, size_t length, uint64_t hash);
+
+// File loading
+char* read_text_file(const char* path);
+
 #endif  // UTIL_H
\ No newline at end of file
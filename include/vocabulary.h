@@ -0,0 +1,11 @@
+#ifndef VOCABULARY_H
+#define VOCABULARY_H
+
+#include "metal.h"
+
+// Wordlist words (VOCABULARY ALSO ONLY DEFINITIONS ...) for the dictionary.
+// Changing the search order is an effect, so files that do it are never
+// cached by INCLUDE.
+extern const word_table_t vocabulary_words;
+
+#endif  // VOCABULARY_H
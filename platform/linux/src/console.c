@@ -0,0 +1,18 @@
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "console.h"
+
+void console_write(const char* data, size_t length) {
+  fflush(stdout);  // The line editor still writes through stdio
+  while (length > 0) {
+    const ssize_t written = write(STDOUT_FILENO, data, length);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return;  // Nowhere to report it
+    }
+    data += written;
+    length -= (size_t)written;
+  }
+}
@@ -0,0 +1,33 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image_file.h"
+
+bool map_image_file(const char* path, image_file_t* file) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  const size_t length = (size_t)info.st_size;
+  void* data =
+      mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);  // The mapping keeps the file open
+  if (data == MAP_FAILED) return false;
+
+  file->data = data;
+  file->length = length;
+  return true;
+}
+
+void unmap_image_file(image_file_t* file) {
+  munmap(file->data, file->length);
+  file->data = NULL;
+  file->length = 0;
+}
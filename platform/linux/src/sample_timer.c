@@ -0,0 +1,43 @@
+#define _DEFAULT_SOURCE  // sigaction, setitimer
+
+#include <signal.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "sample_timer.h"
+
+static void (*sample_tick)(void);
+
+static void on_sigprof([[maybe_unused]] int signal) { sample_tick(); }
+
+bool sample_timer_available(void) { return true; }
+
+bool start_sample_timer(int hz, void (*tick)(void)) {
+  sample_tick = tick;
+
+  struct sigaction action = {0};
+  action.sa_handler = on_sigprof;
+  action.sa_flags = SA_RESTART;  // Reads and writes carry on after a tick
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) return false;
+
+  const long period_us = 1000000 / hz;
+  const struct itimerval timer = {
+      .it_interval = {.tv_sec = period_us / 1000000,
+                      .tv_usec = period_us % 1000000},
+      .it_value = {.tv_sec = period_us / 1000000,
+                   .tv_usec = period_us % 1000000},
+  };
+  return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+void stop_sample_timer(void) {
+  const struct itimerval off = {0};
+  setitimer(ITIMER_PROF, &off, NULL);
+
+  // A tick already pending is dropped
+  struct sigaction action = {0};
+  action.sa_handler = SIG_IGN;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
+}
@@ -0,0 +1,54 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source_file.h"
+
+// The file is mapped over the start of a zeroed anonymous region one page
+// longer than it, so the byte after the text is always a mapped '\0'
+bool open_source_file(const char* path, source_file_t* file) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close(fd);
+    return false;
+  }
+
+  const size_t length = (size_t)info.st_size;
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t reserved = (length / page + 1) * page;
+
+  char* base = mmap(NULL, reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  if (length > 0 &&
+      mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+          MAP_FAILED) {
+    munmap(base, reserved);
+    close(fd);
+    return false;
+  }
+  close(fd);  // The mapping keeps the file open
+
+  // Source is read front to back exactly once
+  madvise(base, reserved, MADV_SEQUENTIAL);
+
+  file->text = base;
+  file->length = length;
+  return true;
+}
+
+void close_source_file(source_file_t* file) {
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  munmap((void*)file->text, (file->length / page + 1) * page);
+  file->text = NULL;
+  file->length = 0;
+}
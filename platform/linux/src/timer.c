@@ -0,0 +1,11 @@
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+
+#include <time.h>
+
+#include "timer.h"
+
+uint64_t timer_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
@@ -0,0 +1,9 @@
+#include <stdio.h>
+
+#include "console.h"
+
+// One block per call reaches the USB CDC driver as a single transfer
+void console_write(const char* data, size_t length) {
+  fwrite(data, 1, length, stdout);
+  fflush(stdout);
+}
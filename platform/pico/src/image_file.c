@@ -0,0 +1,9 @@
+#include "image_file.h"
+
+// There is no file system to map an image from
+bool map_image_file([[maybe_unused]] const char* path,
+                    [[maybe_unused]] image_file_t* file) {
+  return false;
+}
+
+void unmap_image_file([[maybe_unused]] image_file_t* file) {}
@@ -0,0 +1,11 @@
+#include "sample_timer.h"
+
+// There is no CPU-time timer to sample on
+bool sample_timer_available(void) { return false; }
+
+bool start_sample_timer([[maybe_unused]] int hz,
+                        [[maybe_unused]] void (*tick)(void)) {
+  return false;
+}
+
+void stop_sample_timer(void) {}
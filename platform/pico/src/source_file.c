@@ -0,0 +1,9 @@
+#include "source_file.h"
+
+// There is no file system; scripts arrive over the serial REPL
+bool open_source_file([[maybe_unused]] const char* path,
+                      [[maybe_unused]] source_file_t* file) {
+  return false;
+}
+
+void close_source_file([[maybe_unused]] source_file_t* file) {}
@@ -0,0 +1,6 @@
+#include "timer.h"
+
+#include "pico/time.h"
+
+// The Pico timer counts microseconds
+uint64_t timer_ns(void) { return time_us_64() * 1000u; }
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+#include "console.h"
+
+void console_write(const char* data, size_t length) {
+  fwrite(data, 1, length, stdout);
+  fflush(stdout);
+}
@@ -0,0 +1,34 @@
+#include <windows.h>
+
+#include "image_file.h"
+
+bool map_image_file(const char* path, image_file_t* file) {
+  HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+    CloseHandle(handle);
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(handle);  // The mapping keeps the file open
+  if (!mapping) return false;
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  CloseHandle(mapping);  // So does the view
+  if (!data) return false;
+
+  file->data = data;
+  file->length = (size_t)size.QuadPart;
+  return true;
+}
+
+void unmap_image_file(image_file_t* file) {
+  UnmapViewOfFile(file->data);
+  file->data = NULL;
+  file->length = 0;
+}
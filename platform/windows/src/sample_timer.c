@@ -0,0 +1,12 @@
+#include "sample_timer.h"
+
+// Windows has no SIGPROF; sampling would need a thread that suspends the
+// interpreter's
+bool sample_timer_available(void) { return false; }
+
+bool start_sample_timer([[maybe_unused]] int hz,
+                        [[maybe_unused]] void (*tick)(void)) {
+  return false;
+}
+
+void stop_sample_timer(void) {}
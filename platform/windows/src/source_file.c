@@ -0,0 +1,22 @@
+#include "source_file.h"
+
+#include <string.h>
+
+#include "memory.h"
+#include "util.h"
+
+// Without mmap the file is read whole into memory
+bool open_source_file(const char* path, source_file_t* file) {
+  char* text = read_text_file(path);
+  if (!text) return false;
+
+  file->text = text;
+  file->length = strlen(text);
+  return true;
+}
+
+void close_source_file(source_file_t* file) {
+  metal_free((void*)file->text);
+  file->text = NULL;
+  file->length = 0;
+}
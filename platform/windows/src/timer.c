@@ -0,0 +1,16 @@
+#include <windows.h>
+
+#include "timer.h"
+
+uint64_t timer_ns(void) {
+  static LARGE_INTEGER frequency;
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+
+  // Split to avoid overflowing the multiplication
+  uint64_t seconds = now.QuadPart / frequency.QuadPart;
+  uint64_t rest = now.QuadPart % frequency.QuadPart;
+  return seconds * 1000000000u + rest * 1000000000u / frequency.QuadPart;
+}
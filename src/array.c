@@ -3,8 +3,8 @@
 #include <stddef.h>
 
 #include "cell.h"
-#include "debug.h"
 #include "memory.h"
+#include "trace.h"
 
 // Array data management functions
 
@@ -15,13 +15,14 @@ array_data_t* create_array_data(size_t initial_capacity) {
       sizeof(array_data_t) + (initial_capacity * sizeof(cell_t));
   array_data_t* data = metal_alloc(alloc_size);
   if (!data) {
-    debug("Failed to allocate array data for capacity %zu", initial_capacity);
+    trace(TRACE_ARRAY_CREATE_FAIL, initial_capacity);
     return NULL;
   }
+  count_cell_alloc(CELL_ARRAY);
 
   data->length = 0;
   data->capacity = initial_capacity;
-  debug("Created array data with capacity %zu", initial_capacity);
+  trace(TRACE_ARRAY_CREATE, initial_capacity);
   return data;
 }
 
@@ -30,14 +31,12 @@ array_data_t* resize_array_data(array_data_t* data, size_t new_capacity) {
   size_t alloc_size = sizeof(array_data_t) + (new_capacity * sizeof(cell_t));
   array_data_t* new_data = metal_realloc(data, alloc_size);
   if (!new_data) {
-    debug("Failed to resize array data from %zu to %zu", data->capacity,
-          new_capacity);
+    trace(TRACE_ARRAY_RESIZE_FAIL, data->capacity, new_capacity);
     return NULL;
   }
 
   new_data->capacity = new_capacity;
-  debug("Resized array data from capacity %zu to %zu", data->capacity,
-        new_capacity);
+  trace(TRACE_ARRAY_RESIZE, data->capacity, new_capacity);
   return new_data;
 }
 
@@ -0,0 +1,482 @@
+#include "bench.h"
+
+#ifdef BENCH_ENABLED
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bigint.h"
+#include "dictionary.h"
+#include "epoch.h"
+#include "fixed.h"
+#include "image.h"
+#include "loader.h"
+#include "math.h"
+#include "memory.h"
+#include "metal.h"
+#include "output.h"
+#include "parser.h"
+#include "source_file.h"
+#include "stack.h"
+#include "timer.h"
+
+#define BENCH_TYPES 6
+#define KERNEL_LENGTH 64
+#define SIGNAL_LENGTH 1024
+#define FILTER_TAPS 16
+
+typedef struct {
+  const char* name;
+  cell_t (*func)(const cell_t* a, const cell_t* b);
+} bench_op_t;
+
+static const bench_op_t bench_ops[] = {
+    {"+", add_cells},       {"-", subtract_cells}, {"*", multiply_cells},
+    {"/", divide_cells},    {"MOD", mod_cells},    {"<", less_cells},
+    {"=", equal_cells},
+};
+
+#define BENCH_OP_COUNT (sizeof(bench_ops) / sizeof(bench_ops[0]))
+
+static const char* const bench_type_names[BENCH_TYPES] = {
+    "i32", "i64", "big", "fix", "f32", "flt"};
+
+// BENCH-MATH ( n -- ) Time every operation for every pair of operand types
+static void native_bench_math(context_t* ctx) {
+  if (ctx->data_stack_ptr < 1) {
+    error("BENCH-MATH: stack underflow");
+    return;
+  }
+
+  cell_t count = data_pop(ctx);
+  if (count.type != CELL_INT32 || count.payload.i32 <= 0) {
+    error("BENCH-MATH: iteration count must be a positive integer");
+    return;
+  }
+  const int32_t iterations = count.payload.i32;
+
+  // Left and right operands of each type; no pair divides by zero and only
+  // the bigint ones leave the unboxed types
+  cell_t left[BENCH_TYPES] = {new_int32(1000003), new_int64(5000000000011),
+                              new_empty(), new_fixed(1234 * FIXED_ONE),
+                              new_float32(1234.5f), new_float(1234.5)};
+  cell_t right[BENCH_TYPES] = {new_int32(7), new_int64(7), new_empty(),
+                               new_fixed(7 * FIXED_ONE + FIXED_ONE / 4),
+                               new_float32(7.25f), new_float(7.25)};
+  parse_bigint("123456789012345678901234567890", &left[2]);
+  parse_bigint("98765432109876543210", &right[2]);
+
+  output_format("ns per operation over %d iterations\n       ", iterations);
+  for (size_t op = 0; op < BENCH_OP_COUNT; op++) {
+    output_format(" %7s", bench_ops[op].name);
+  }
+  output_char('\n');
+
+  for (int x = 0; x < BENCH_TYPES; x++) {
+    for (int y = 0; y < BENCH_TYPES; y++) {
+      output_format("%s,%s", bench_type_names[x], bench_type_names[y]);
+      for (size_t op = 0; op < BENCH_OP_COUNT; op++) {
+        uint64_t start = timer_ns();
+        for (int32_t i = 0; i < iterations; i++) {
+          cell_t result = bench_ops[op].func(&left[x], &right[y]);
+          metal_release(&result);
+        }
+        uint64_t elapsed = timer_ns() - start;
+        output_format(" %7.1f", (double)elapsed / iterations);
+      }
+      output_char('\n');
+    }
+  }
+
+  for (int i = 0; i < BENCH_TYPES; i++) {
+    metal_release(&left[i]);
+    metal_release(&right[i]);
+  }
+}
+
+// Float kernels, instantiated for each precision. The multiply-add is the
+// inner loop of a filter; division is the slowest soft-float operation.
+// The kernels are pure, so each run first tells the compiler the inputs
+// may have changed; otherwise it computes them once, outside the loop.
+#define CLOBBER_INPUTS(x, y) __asm__ volatile("" : : "r"(x), "r"(y) : "memory")
+
+#define FLOAT_KERNELS(type)                                                \
+  static type multiply_add_##type(const type* x, const type* y) {          \
+    type sum = 0;                                                          \
+    for (size_t i = 0; i < KERNEL_LENGTH; i++) sum += x[i] * y[i];         \
+    return sum;                                                            \
+  }                                                                        \
+                                                                           \
+  static type divide_##type(const type* x, const type* y) {                \
+    type sum = 0;                                                          \
+    for (size_t i = 0; i < KERNEL_LENGTH; i++) sum += x[i] / y[i];         \
+    return sum;                                                            \
+  }                                                                        \
+                                                                           \
+  static void time_##type(int32_t iterations, uint64_t* elapsed) {         \
+    type x[KERNEL_LENGTH], y[KERNEL_LENGTH];                               \
+    for (size_t i = 0; i < KERNEL_LENGTH; i++) {                           \
+      x[i] = (type)(i + 1) / 3;                                            \
+      y[i] = (type)(KERNEL_LENGTH - i) / 7;                                \
+    }                                                                      \
+                                                                           \
+    volatile type sink = 0;                                                \
+    uint64_t start = timer_ns();                                           \
+    for (int32_t i = 0; i < iterations; i++) {                             \
+      CLOBBER_INPUTS(x, y);                                                \
+      sink += multiply_add_##type(x, y);                                   \
+    }                                                                      \
+    elapsed[0] = timer_ns() - start;                                       \
+                                                                           \
+    start = timer_ns();                                                    \
+    for (int32_t i = 0; i < iterations; i++) {                             \
+      CLOBBER_INPUTS(x, y);                                                \
+      sink += divide_##type(x, y);                                         \
+    }                                                                      \
+    elapsed[1] = timer_ns() - start;                                       \
+  }
+
+FLOAT_KERNELS(float)
+FLOAT_KERNELS(double)
+
+// BENCH-FLOAT ( n -- ) Compare float32 and float64 kernel throughput
+static void native_bench_float(context_t* ctx) {
+  if (ctx->data_stack_ptr < 1) {
+    error("BENCH-FLOAT: stack underflow");
+    return;
+  }
+
+  cell_t count = data_pop(ctx);
+  if (count.type != CELL_INT32 || count.payload.i32 <= 0) {
+    error("BENCH-FLOAT: iteration count must be a positive integer");
+    return;
+  }
+  const int32_t iterations = count.payload.i32;
+
+  uint64_t float32_ns[2], float64_ns[2];
+  time_float(iterations, float32_ns);
+  time_double(iterations, float64_ns);
+
+  static const char* const kernels[2] = {"multiply-add", "divide"};
+  const double elements = (double)iterations * KERNEL_LENGTH;
+  output_format("ns per element over %d x %d elements\n", iterations,
+                KERNEL_LENGTH);
+  output_format("%-12s %9s %9s %7s\n", "", "float32", "float64", "ratio");
+  for (int k = 0; k < 2; k++) {
+    output_format("%-12s %9.2f %9.2f %6.2fx\n", kernels[k],
+                  float32_ns[k] / elements, float64_ns[k] / elements,
+                  (double)float64_ns[k] / float32_ns[k]);
+  }
+}
+
+// Float references for the fixed-point kernels, same algorithms
+#define REFERENCE_KERNELS(type)                                            \
+  static void fir_##type(const type* input, const type* taps,              \
+                         type* output) {                                   \
+    for (size_t n = 0; n < SIGNAL_LENGTH; n++) {                           \
+      const size_t count = n + 1 < FILTER_TAPS ? n + 1 : FILTER_TAPS;      \
+      type sum = 0;                                                        \
+      for (size_t k = 0; k < count; k++) sum += taps[k] * input[n - k];    \
+      output[n] = sum;                                                     \
+    }                                                                      \
+  }                                                                        \
+                                                                           \
+  static void moving_average_##type(const type* input, type* output) {    \
+    type sum = 0;                                                          \
+    for (size_t n = 0; n < SIGNAL_LENGTH; n++) {                           \
+      sum += input[n];                                                     \
+      if (n >= FILTER_TAPS) sum -= input[n - FILTER_TAPS];                 \
+      output[n] = sum / (type)(n < FILTER_TAPS ? n + 1 : FILTER_TAPS);     \
+    }                                                                      \
+  }
+
+REFERENCE_KERNELS(float)
+REFERENCE_KERNELS(double)
+
+typedef struct {
+  double signal[SIGNAL_LENGTH], taps[FILTER_TAPS];
+  float signal32[SIGNAL_LENGTH], taps32[FILTER_TAPS];
+  int32_t signalq[SIGNAL_LENGTH], tapsq[FILTER_TAPS];
+  double reference[SIGNAL_LENGTH];
+  float output32[SIGNAL_LENGTH];
+  int32_t outputq[SIGNAL_LENGTH];
+} dsp_bench_t;
+
+// A unit triangle wave with pseudo-random noise, and a triangular low-pass
+// filter whose taps sum to one
+static void make_signal(dsp_bench_t* b) {
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++) {
+    seed = seed * 1103515245u + 12345u;
+    const double noise = ((seed >> 16) & 0x7FFF) / 32768.0 - 0.5;
+    const double phase = (double)(i % 64) / 32.0;
+    b->signal[i] = (phase < 1 ? phase : 2 - phase) * 2 - 1 + noise * 0.2;
+  }
+
+  double total = 0;
+  for (size_t k = 0; k < FILTER_TAPS; k++) {
+    b->taps[k] = (double)(k < FILTER_TAPS / 2 ? k + 1 : FILTER_TAPS - k);
+    total += b->taps[k];
+  }
+  for (size_t k = 0; k < FILTER_TAPS; k++) b->taps[k] /= total;
+
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++) {
+    b->signal32[i] = (float)b->signal[i];
+    b->signalq[i] = fixed_from_double(b->signal[i]);
+  }
+  for (size_t k = 0; k < FILTER_TAPS; k++) {
+    b->taps32[k] = (float)b->taps[k];
+    b->tapsq[k] = fixed_from_double(b->taps[k]);
+  }
+}
+
+static void report_errors(const dsp_bench_t* b, double* error32,
+                          double* errorq) {
+  *error32 = 0;
+  *errorq = 0;
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++) {
+    double e32 = b->output32[i] - b->reference[i];
+    double eq = fixed_to_double(b->outputq[i]) - b->reference[i];
+    if (e32 < 0) e32 = -e32;
+    if (eq < 0) eq = -eq;
+    if (e32 > *error32) *error32 = e32;
+    if (eq > *errorq) *errorq = eq;
+  }
+}
+
+// BENCH-FIXED ( n -- ) Fixed-point kernels against float, accuracy and speed
+static void native_bench_fixed(context_t* ctx) {
+  if (ctx->data_stack_ptr < 1) {
+    error("BENCH-FIXED: stack underflow");
+    return;
+  }
+
+  cell_t count = data_pop(ctx);
+  if (count.type != CELL_INT32 || count.payload.i32 <= 0) {
+    error("BENCH-FIXED: iteration count must be a positive integer");
+    return;
+  }
+  const int32_t iterations = count.payload.i32;
+
+  dsp_bench_t* b = metal_alloc(sizeof(dsp_bench_t));
+  if (!b) return;
+  memset(b, 0, sizeof(dsp_bench_t));
+  make_signal(b);
+
+  const double samples = (double)iterations * SIGNAL_LENGTH;
+  output_format("%d x %d samples, %d taps/window; error is max |x - double|\n",
+                iterations, SIGNAL_LENGTH, FILTER_TAPS);
+  output_format("%-15s %10s %10s %12s %12s\n", "", "f32 ns", "Q16.16 ns",
+                "f32 error", "Q16.16 error");
+
+  double error32, errorq;
+  uint64_t start, float_ns, fixed_ns;
+
+  // FIR filter
+  fir_double(b->signal, b->taps, b->reference);
+  start = timer_ns();
+  for (int32_t i = 0; i < iterations; i++) {
+    fir_float(b->signal32, b->taps32, b->output32);
+  }
+  float_ns = timer_ns() - start;
+  start = timer_ns();
+  for (int32_t i = 0; i < iterations; i++) {
+    fixed_fir(b->signalq, SIGNAL_LENGTH, b->tapsq, FILTER_TAPS, b->outputq);
+  }
+  fixed_ns = timer_ns() - start;
+  report_errors(b, &error32, &errorq);
+  output_format("%-15s %10.2f %10.2f %12.3g %12.3g\n", "FIR",
+                float_ns / samples, fixed_ns / samples, error32, errorq);
+
+  // Moving average
+  moving_average_double(b->signal, b->reference);
+  start = timer_ns();
+  for (int32_t i = 0; i < iterations; i++) {
+    moving_average_float(b->signal32, b->output32);
+  }
+  float_ns = timer_ns() - start;
+  start = timer_ns();
+  for (int32_t i = 0; i < iterations; i++) {
+    fixed_moving_average(b->signalq, SIGNAL_LENGTH, FILTER_TAPS, b->outputq);
+  }
+  fixed_ns = timer_ns() - start;
+  report_errors(b, &error32, &errorq);
+  output_format("%-15s %10.2f %10.2f %12.3g %12.3g\n", "MOVING-AVERAGE",
+                float_ns / samples, fixed_ns / samples, error32, errorq);
+
+  metal_free(b);
+}
+
+// The interpreter's parse before it had its own scanner: copy the token out
+// of the source, then strtoll and strtod
+static bool libc_parse_number(const char* source, size_t length,
+                              cell_t* result) {
+  char token[256];
+  if (length >= sizeof(token)) return false;
+  strncpy(token, source, length);
+  token[length] = '\0';
+
+  char* end;
+  errno = 0;
+  const long long value = strtoll(token, &end, 10);
+  if (*end == '\0') {
+    if (errno == ERANGE) return parse_bigint(token, result);
+    *result = value >= INT32_MIN && value <= INT32_MAX
+                  ? new_int32((int32_t)value)
+                  : new_int64(value);
+    return true;
+  }
+
+  const double fvalue = strtod(token, &end);
+  if (*end != '\0') return false;
+  *result = new_float(fvalue);
+  return true;
+}
+
+typedef struct {
+  const char* name;
+  const char* const* tokens;
+  size_t count;
+} parse_set_t;
+
+#define PARSE_SET_SIZE 8
+
+static const char* const parse_words[PARSE_SET_SIZE] = {
+    "DUP", "SWAP", "OVER", "+", "2DUP", "@", "IF", "ROT"};
+static const char* const parse_integers[PARSE_SET_SIZE] = {
+    "0", "42", "-7", "65535", "123456789", "-2147483648", "9000000000", "17"};
+static const char* const parse_decimals[PARSE_SET_SIZE] = {
+    "3.14159", "-0.5", "2.5e-3", "1234.5678", "6.02e23", "0.1", "-1e-7", "1.5"};
+
+#define PARSE_SET(name, tokens) {name, tokens, PARSE_SET_SIZE}
+
+static const parse_set_t parse_sets[] = {
+    PARSE_SET("words", parse_words),
+    PARSE_SET("integers", parse_integers),
+    PARSE_SET("decimals", parse_decimals),
+};
+
+// Time one parser over a set, returning ns per token
+static double time_parser(bool (*parse)(const char*, size_t, cell_t*),
+                          const parse_set_t* set, int32_t iterations) {
+  size_t lengths[PARSE_SET_SIZE];
+  for (size_t t = 0; t < set->count; t++) {
+    lengths[t] = strlen(set->tokens[t]);
+  }
+
+  const uint64_t start = timer_ns();
+  for (int32_t i = 0; i < iterations; i++) {
+    for (size_t t = 0; t < set->count; t++) {
+      cell_t cell;
+      if (parse(set->tokens[t], lengths[t], &cell)) metal_release(&cell);
+    }
+  }
+  return (double)(timer_ns() - start) / ((double)iterations * set->count);
+}
+
+// BENCH-PARSE ( n -- ) Number scanner against copy + strtoll + strtod
+static void native_bench_parse(context_t* ctx) {
+  if (ctx->data_stack_ptr < 1) {
+    error("BENCH-PARSE: stack underflow");
+    return;
+  }
+
+  cell_t count = data_pop(ctx);
+  if (count.type != CELL_INT32 || count.payload.i32 <= 0) {
+    error("BENCH-PARSE: iteration count must be a positive integer");
+    return;
+  }
+  const int32_t iterations = count.payload.i32;
+
+  output_format("ns per token over %d iterations\n", iterations);
+  output_format("%-10s %10s %10s %8s\n", "", "libc", "scanner", "speedup");
+  for (size_t i = 0; i < sizeof(parse_sets) / sizeof(*parse_sets); i++) {
+    const parse_set_t* set = &parse_sets[i];
+    const double libc_ns = time_parser(libc_parse_number, set, iterations);
+    const double scan_ns = time_parser(try_parse_number, set, iterations);
+    output_format("%-10s %10.1f %10.1f %7.1fx\n", set->name, libc_ns, scan_ns,
+                  libc_ns / scan_ns);
+  }
+}
+
+// BENCH-BOOT ( source image n -- ) Time adding a program's definitions by
+// interpreting its source and by loading its image, forgetting them after
+// each boot
+static void native_bench_boot(context_t* ctx) {
+  if (ctx->data_stack_ptr < 3) {
+    error("BENCH-BOOT: stack underflow");
+    return;
+  }
+
+  cell_t count = data_pop(ctx);
+  cell_t image_path = data_pop(ctx);
+  cell_t source_path = data_pop(ctx);
+  if (count.type != CELL_INT32 || count.payload.i32 <= 0 ||
+      image_path.type != CELL_STRING || source_path.type != CELL_STRING) {
+    metal_release(&image_path);
+    metal_release(&source_path);
+    error("BENCH-BOOT: expects a source path, an image path and a count");
+    return;
+  }
+  const int32_t iterations = count.payload.i32;
+
+  source_file_t file;
+  if (!open_source_file(source_path.payload.ptr, &file)) {
+    metal_release(&image_path);
+    metal_release(&source_path);
+    error("BENCH-BOOT: cannot read source");
+    return;
+  }
+
+  const int mark = get_dictionary_size();
+  uint64_t source_ns = 0;
+  uint64_t image_ns = 0;
+  const char* failure = NULL;
+  for (int32_t i = 0; i < iterations && !failure; i++) {
+    uint64_t start = timer_ns();
+    if (!interpret_nested(ctx, file.text)) failure = "error in source";
+    source_ns += timer_ns() - start;
+    forget_words(mark);
+    if (failure) break;
+
+    image_file_t image;
+    start = timer_ns();
+    failure = load_image(image_path.payload.ptr, &image);
+    image_ns += timer_ns() - start;
+    forget_words(mark);
+    epoch_synchronize();  // Nothing may still reach the mapping
+    if (!failure) unmap_image_file(&image);
+  }
+
+  close_source_file(&file);
+  metal_release(&image_path);
+  metal_release(&source_path);
+  if (failure) {
+    error("BENCH-BOOT: %s", failure);
+    return;
+  }
+
+  const double source_ms = source_ns / 1e6 / iterations;
+  const double image_ms = image_ns / 1e6 / iterations;
+  output_format("ms per boot over %d iterations\n", iterations);
+  output_format("%-10s %10.3f\n", "source", source_ms);
+  output_format("%-10s %10.3f\n", "image", image_ms);
+  output_format("%-10s %9.1fx\n", "speedup", source_ms / image_ms);
+}
+
+// Benchmark words
+static const dictionary_entry_t bench_entries[] = {
+    NATIVE_WORD("BENCH-MATH", native_bench_math,
+                "( n -- ) Time arithmetic for each pair of numeric types"),
+    NATIVE_WORD("BENCH-FLOAT", native_bench_float,
+                "( n -- ) Compare float32 and float64 kernel throughput"),
+    NATIVE_WORD("BENCH-FIXED", native_bench_fixed,
+                "( n -- ) Compare fixed-point kernels with float"),
+    NATIVE_WORD("BENCH-PARSE", native_bench_parse,
+                "( n -- ) Compare the number scanner with libc parsing"),
+    NATIVE_WORD("BENCH-BOOT", native_bench_boot,
+                "( source image n -- ) Compare source and image startup"),
+};
+const word_table_t bench_words = WORD_TABLE(bench_entries);
+
+#endif
@@ -0,0 +1,484 @@
+#include "bigint.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "math.h"
+#include "memory.h"
+#include "trace.h"
+
+// Below this many limbs schoolbook multiplication beats Karatsuba
+#define KARATSUBA_THRESHOLD 32
+
+// An integer cell of any width seen as sign and magnitude. The view points
+// into its own storage for int32 and int64 cells, so it must not be copied.
+typedef struct {
+  const uint32_t* limbs;
+  size_t length;
+  bool negative;
+  uint32_t small[2];
+} integer_view_t;
+
+static void view_integer(const cell_t* cell, integer_view_t* view) {
+  if (cell->type == CELL_BIGINT) {
+    const bigint_data_t* data = cell->payload.ptr;
+    view->limbs = data->limbs;
+    view->length = data->length;
+    view->negative = data->negative;
+    return;
+  }
+
+  int64_t value =
+      cell->type == CELL_INT32 ? cell->payload.i32 : cell->payload.i64;
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  view->small[0] = (uint32_t)magnitude;
+  view->small[1] = (uint32_t)(magnitude >> 32);
+  view->limbs = view->small;
+  view->length = view->small[1] ? 2 : view->small[0] ? 1 : 0;
+  view->negative = value < 0;
+}
+
+// Magnitude helpers. Limbs are least significant first.
+
+static uint32_t* new_limbs(size_t length) {
+  if (length == 0) length = 1;
+  uint32_t* limbs = metal_alloc(length * sizeof(uint32_t));
+  memset(limbs, 0, length * sizeof(uint32_t));
+  return limbs;
+}
+
+static size_t trim(const uint32_t* limbs, size_t length) {
+  while (length > 0 && limbs[length - 1] == 0) length--;
+  return length;
+}
+
+static int compare_magnitudes(const uint32_t* a, size_t an, const uint32_t* b,
+                              size_t bn) {
+  if (an != bn) return an < bn ? -1 : 1;
+  for (size_t i = an; i-- > 0;) {
+    if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+// r += a, where the sum fits in rn limbs and an <= rn
+static void add_into(uint32_t* r, size_t rn, const uint32_t* a, size_t an) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < an; i++) {
+    carry += (uint64_t)r[i] + a[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  for (; carry && i < rn; i++) {
+    carry += r[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+}
+
+// r -= a, where r >= a
+static void subtract_into(uint32_t* r, size_t rn, const uint32_t* a,
+                          size_t an) {
+  int64_t borrow = 0;
+  size_t i = 0;
+  for (; i < an; i++) {
+    int64_t difference = (int64_t)r[i] - a[i] - borrow;
+    r[i] = (uint32_t)difference;
+    borrow = difference < 0;
+  }
+  for (; borrow && i < rn; i++) {
+    int64_t difference = (int64_t)r[i] - borrow;
+    r[i] = (uint32_t)difference;
+    borrow = difference < 0;
+  }
+}
+
+// r += a * b, where r has an + bn limbs
+static void multiply_schoolbook(uint32_t* r, const uint32_t* a, size_t an,
+                                const uint32_t* b, size_t bn) {
+  for (size_t i = 0; i < an; i++) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < bn; j++) {
+      carry += (uint64_t)a[i] * b[j] + r[i + j];
+      r[i + j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    r[i + bn] = (uint32_t)carry;
+  }
+}
+
+// r = a * b, where r has an + bn zeroed limbs
+static void multiply_magnitudes(uint32_t* r, const uint32_t* a, size_t an,
+                                const uint32_t* b, size_t bn) {
+  if (an < bn) {
+    const uint32_t* swap = a;
+    a = b;
+    b = swap;
+    size_t swap_length = an;
+    an = bn;
+    bn = swap_length;
+  }
+
+  if (bn < KARATSUBA_THRESHOLD) {
+    multiply_schoolbook(r, a, an, b, bn);
+    return;
+  }
+
+  const size_t m = an / 2;
+  const size_t rn = an + bn;
+
+  if (bn <= m) {
+    // Too lopsided to split both: multiply b by each half of a
+    uint32_t* part = new_limbs(an - m + bn);
+    multiply_magnitudes(part, a, m, b, bn);
+    add_into(r, rn, part, trim(part, m + bn));
+    memset(part, 0, (an - m + bn) * sizeof(uint32_t));
+    multiply_magnitudes(part, a + m, an - m, b, bn);
+    add_into(r + m, rn - m, part, trim(part, an - m + bn));
+    metal_free(part);
+    return;
+  }
+
+  // Karatsuba: with a = a1*B^m + a0 and b = b1*B^m + b0,
+  // a*b = z2*B^2m + z1*B^m + z0 where z1 = (a0+a1)(b0+b1) - z0 - z2
+  const size_t a1n = an - m;
+  const size_t b1n = bn - m;
+
+  uint32_t* z0 = new_limbs(2 * m);
+  multiply_magnitudes(z0, a, m, b, m);
+  uint32_t* z2 = new_limbs(a1n + b1n);
+  multiply_magnitudes(z2, a + m, a1n, b + m, b1n);
+
+  const size_t san = a1n + 1;  // a1 is at least as long as a0
+  const size_t sbn = (b1n > m ? b1n : m) + 1;
+  uint32_t* sa = new_limbs(san);
+  memcpy(sa, a + m, a1n * sizeof(uint32_t));
+  add_into(sa, san, a, m);
+  uint32_t* sb = new_limbs(sbn);
+  memcpy(sb, b, m * sizeof(uint32_t));
+  add_into(sb, sbn, b + m, b1n);
+
+  uint32_t* z1 = new_limbs(san + sbn);
+  multiply_magnitudes(z1, sa, san, sb, sbn);
+  subtract_into(z1, san + sbn, z0, 2 * m);
+  subtract_into(z1, san + sbn, z2, a1n + b1n);
+
+  add_into(r, rn, z0, trim(z0, 2 * m));
+  add_into(r + m, rn - m, z1, trim(z1, san + sbn));
+  add_into(r + 2 * m, rn - 2 * m, z2, trim(z2, a1n + b1n));
+
+  metal_free(z0);
+  metal_free(z1);
+  metal_free(z2);
+  metal_free(sa);
+  metal_free(sb);
+}
+
+// q = a / b and r = a % b (Knuth's algorithm D), where an >= bn > 0, b is
+// trimmed, q has an - bn + 1 limbs and r has bn limbs
+static void divide_magnitudes(uint32_t* q, uint32_t* r, const uint32_t* a,
+                              size_t an, const uint32_t* b, size_t bn) {
+  if (bn == 1) {
+    uint64_t remainder = 0;
+    for (size_t i = an; i-- > 0;) {
+      uint64_t current = (remainder << 32) | a[i];
+      q[i] = (uint32_t)(current / b[0]);
+      remainder = current % b[0];
+    }
+    r[0] = (uint32_t)remainder;
+    return;
+  }
+
+  // Normalize so the divisor's top limb has its high bit set; this keeps
+  // each quotient estimate within two of the true digit
+  const int s = __builtin_clz(b[bn - 1]);
+  uint32_t* vn = new_limbs(bn);
+  uint32_t* un = new_limbs(an + 1);
+  for (size_t i = bn - 1; i > 0; i--) {
+    vn[i] = (b[i] << s) | (uint32_t)((uint64_t)b[i - 1] >> (32 - s));
+  }
+  vn[0] = b[0] << s;
+  un[an] = (uint32_t)((uint64_t)a[an - 1] >> (32 - s));
+  for (size_t i = an - 1; i > 0; i--) {
+    un[i] = (a[i] << s) | (uint32_t)((uint64_t)a[i - 1] >> (32 - s));
+  }
+  un[0] = a[0] << s;
+
+  for (size_t j = an - bn + 1; j-- > 0;) {
+    // Estimate the quotient digit from the top limbs
+    uint64_t numerator = ((uint64_t)un[j + bn] << 32) | un[j + bn - 1];
+    uint64_t qhat = numerator / vn[bn - 1];
+    uint64_t rhat = numerator % vn[bn - 1];
+    while (qhat >> 32 ||
+           qhat * vn[bn - 2] > ((rhat << 32) | un[j + bn - 2])) {
+      qhat--;
+      rhat += vn[bn - 1];
+      if (rhat >> 32) break;
+    }
+
+    // Multiply and subtract
+    int64_t borrow = 0;
+    int64_t t;
+    for (size_t i = 0; i < bn; i++) {
+      uint64_t product = qhat * vn[i];
+      t = (int64_t)un[i + j] - borrow - (int64_t)(product & 0xFFFFFFFF);
+      un[i + j] = (uint32_t)t;
+      borrow = (int64_t)(product >> 32) - (t >> 32);
+    }
+    t = (int64_t)un[j + bn] - borrow;
+    un[j + bn] = (uint32_t)t;
+
+    // The estimate was one too large: add the divisor back
+    q[j] = (uint32_t)qhat;
+    if (t < 0) {
+      q[j]--;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < bn; i++) {
+        carry += (uint64_t)un[i + j] + vn[i];
+        un[i + j] = (uint32_t)carry;
+        carry >>= 32;
+      }
+      un[j + bn] += (uint32_t)carry;
+    }
+  }
+
+  // Denormalize the remainder
+  for (size_t i = 0; i < bn; i++) {
+    r[i] = (un[i] >> s) | (uint32_t)((uint64_t)un[i + 1] << (32 - s));
+  }
+
+  metal_free(vn);
+  metal_free(un);
+}
+
+// Bigint data management
+
+bigint_data_t* create_bigint_data(size_t length) {
+  bigint_data_t* data =
+      metal_alloc(sizeof(bigint_data_t) + length * sizeof(uint32_t));
+  if (!data) {
+    trace(TRACE_BIGINT_CREATE_FAIL, length);
+    return NULL;
+  }
+  count_cell_alloc(CELL_BIGINT);
+
+  data->length = length;
+  data->negative = false;
+  return data;
+}
+
+// Smallest cell holding the value; values that fit in int64 are demoted
+static cell_t make_integer(const uint32_t* limbs, size_t length,
+                           bool negative) {
+  length = trim(limbs, length);
+
+  if (length <= 2) {
+    uint64_t magnitude = length == 0   ? 0
+                         : length == 1 ? limbs[0]
+                                       : (uint64_t)limbs[1] << 32 | limbs[0];
+    if (!negative || magnitude == 0) {
+      if (magnitude <= INT64_MAX) return new_integer((int64_t)magnitude);
+    } else if (magnitude <= (uint64_t)INT64_MAX + 1) {
+      return new_integer(-(int64_t)(magnitude - 1) - 1);
+    }
+  }
+
+  bigint_data_t* data = create_bigint_data(length);
+  if (!data) return new_empty();
+  memcpy(data->limbs, limbs, length * sizeof(uint32_t));
+  data->negative = negative;
+
+  cell_t cell = {0};
+  cell.type = CELL_BIGINT;
+  cell.payload.ptr = data;
+  return cell;
+}
+
+// Arithmetic
+
+static cell_t add_views(const integer_view_t* a, const integer_view_t* b,
+                        bool b_negative) {
+  const size_t length = (a->length > b->length ? a->length : b->length) + 1;
+  uint32_t* sum = new_limbs(length);
+  bool negative;
+
+  if (a->negative == b_negative) {
+    memcpy(sum, a->limbs, a->length * sizeof(uint32_t));
+    add_into(sum, length, b->limbs, b->length);
+    negative = a->negative;
+  } else if (compare_magnitudes(a->limbs, a->length, b->limbs, b->length) >=
+             0) {
+    memcpy(sum, a->limbs, a->length * sizeof(uint32_t));
+    subtract_into(sum, length, b->limbs, b->length);
+    negative = a->negative;
+  } else {
+    memcpy(sum, b->limbs, b->length * sizeof(uint32_t));
+    subtract_into(sum, length, a->limbs, a->length);
+    negative = b_negative;
+  }
+
+  cell_t result = make_integer(sum, length, negative);
+  metal_free(sum);
+  return result;
+}
+
+cell_t bigint_add(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+  return add_views(&x, &y, y.negative);
+}
+
+cell_t bigint_subtract(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+  return add_views(&x, &y, !y.negative);
+}
+
+cell_t bigint_multiply(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+
+  const size_t length = x.length + y.length;
+  uint32_t* product = new_limbs(length);
+  multiply_magnitudes(product, x.limbs, x.length, y.limbs, y.length);
+
+  cell_t result = make_integer(product, length, x.negative != y.negative);
+  metal_free(product);
+  return result;
+}
+
+// Truncating division: the quotient's sign is the product of the signs and
+// the remainder takes the sign of the dividend
+static cell_t divide_views(const integer_view_t* x, const integer_view_t* y,
+                           bool want_quotient) {
+  if (compare_magnitudes(x->limbs, x->length, y->limbs, y->length) < 0) {
+    return want_quotient ? new_int32(0)
+                         : make_integer(x->limbs, x->length, x->negative);
+  }
+
+  uint32_t* quotient = new_limbs(x->length - y->length + 1);
+  uint32_t* remainder = new_limbs(y->length);
+  divide_magnitudes(quotient, remainder, x->limbs, x->length, y->limbs,
+                    y->length);
+
+  cell_t result =
+      want_quotient
+          ? make_integer(quotient, x->length - y->length + 1,
+                         x->negative != y->negative)
+          : make_integer(remainder, y->length, x->negative);
+  metal_free(quotient);
+  metal_free(remainder);
+  return result;
+}
+
+cell_t bigint_divide(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+  return divide_views(&x, &y, true);
+}
+
+cell_t bigint_mod(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+  return divide_views(&x, &y, false);
+}
+
+int bigint_compare(const cell_t* a, const cell_t* b) {
+  integer_view_t x, y;
+  view_integer(a, &x);
+  view_integer(b, &y);
+
+  if (x.negative != y.negative) return x.negative ? -1 : 1;
+  int order = compare_magnitudes(x.limbs, x.length, y.limbs, y.length);
+  return x.negative ? -order : order;
+}
+
+// Conversions
+
+double bigint_to_float(const bigint_data_t* data) {
+  double value = 0.0;
+  for (size_t i = data->length; i-- > 0;) {
+    value = value * 4294967296.0 + data->limbs[i];
+  }
+  return data->negative ? -value : value;
+}
+
+char* bigint_to_string(const bigint_data_t* data) {
+  // A limb holds fewer than ten decimal digits
+  const size_t capacity = data->length * 10 + 2;
+  char* text = metal_alloc(capacity);
+  if (!text) return NULL;
+
+  uint32_t* limbs = new_limbs(data->length);
+  memcpy(limbs, data->limbs, data->length * sizeof(uint32_t));
+  size_t length = data->length;
+
+  // Peel off nine digits at a time, least significant first
+  char* p = text + capacity;
+  *--p = '\0';
+  while (length > 0) {
+    uint64_t chunk = 0;
+    for (size_t i = length; i-- > 0;) {
+      uint64_t current = (chunk << 32) | limbs[i];
+      limbs[i] = (uint32_t)(current / 1000000000);
+      chunk = current % 1000000000;
+    }
+    length = trim(limbs, length);
+
+    // Inner chunks keep their leading zeros
+    for (int digit = 0; digit < 9 && (length > 0 || chunk > 0); digit++) {
+      *--p = (char)('0' + chunk % 10);
+      chunk /= 10;
+    }
+  }
+  if (data->negative) *--p = '-';
+
+  memmove(text, p, strlen(p) + 1);
+  metal_free(limbs);
+  return text;
+}
+
+bool parse_bigint(const char* digits, cell_t* result) {
+  const char* p = digits;
+  bool negative = false;
+  if (*p == '-' || *p == '+') negative = *p++ == '-';
+
+  const size_t count = strlen(p);
+  if (count == 0) return false;
+  for (size_t i = 0; i < count; i++) {
+    if (!isdigit((unsigned char)p[i])) return false;
+  }
+
+  // Consume nine digits at a time: limbs = limbs * 10^n + chunk
+  uint32_t* limbs = new_limbs(count / 9 + 2);
+  size_t length = 0;
+  size_t chunk_digits = count % 9 ? count % 9 : 9;
+  while (*p) {
+    uint32_t chunk = 0;
+    uint32_t scale = 1;
+    for (size_t i = 0; i < chunk_digits; i++) {
+      chunk = chunk * 10 + (uint32_t)(*p++ - '0');
+      scale *= 10;
+    }
+
+    uint64_t carry = chunk;
+    for (size_t i = 0; i < length; i++) {
+      carry += (uint64_t)limbs[i] * scale;
+      limbs[i] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    if (carry) limbs[length++] = (uint32_t)carry;
+    chunk_digits = 9;
+  }
+
+  *result = make_integer(limbs, length, negative);
+  metal_free(limbs);
+  return true;
+}
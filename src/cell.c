@@ -2,9 +2,9 @@
 
 #include <string.h>
 
-#include "debug.h"
 #include "memory.h"
 #include "metal.h"
+#include "trace.h"
 
 // Cell creation functions (fundamental immediate types)
 
@@ -29,19 +29,37 @@ cell_t new_float(double value) {
   return cell;
 }
 
+cell_t new_float32(float value) {
+  cell_t cell = {0};
+  cell.type = CELL_FLOAT32;
+  cell.payload.f32 = value;
+  return cell;
+}
+
+cell_t new_fixed(int32_t raw) {
+  cell_t cell = {0};
+  cell.type = CELL_FIXED;
+  cell.payload.fixed = raw;
+  return cell;
+}
+
 cell_t new_string(const char* utf8) {
+  return new_string_span(utf8, strlen(utf8));
+}
+
+cell_t new_string_span(const char* utf8, size_t length) {
   cell_t cell = {0};
   cell.type = CELL_STRING;
 
-  size_t len = strlen(utf8);
-
   // For now, just allocate all strings. Later we'll optimize for short ones
-  char* allocated = metal_alloc(len + 1);
+  char* allocated = metal_alloc(length + 1);
   if (!allocated) {
     // Return empty on allocation failure
     return new_empty();
   }
-  strcpy(allocated, utf8);
+  count_cell_alloc(CELL_STRING);
+  memcpy(allocated, utf8, length);
+  allocated[length] = '\0';
   cell.payload.ptr = allocated;
 
   return cell;
@@ -86,14 +104,14 @@ void metal_retain(cell_t* cell) {
   // Only allocated types need refcount management
   switch (cell->type) {
     case CELL_STRING:
+    case CELL_BIGINT:
     case CELL_OBJECT:
     case CELL_CODE:
       if (!(cell->flags & CELL_FLAG_WEAK_REF)) {
         alloc_header_t* header = (alloc_header_t*)((char*)cell->payload.ptr -
                                                    sizeof(alloc_header_t));
         header->refcount++;
-        debug("Retained cell type %d, refcount now %d", cell->type,
-              header->refcount);
+        trace(TRACE_RETAIN, cell->type, header->refcount);
       }
       break;
     case CELL_ARRAY:
@@ -101,7 +119,7 @@ void metal_retain(cell_t* cell) {
         alloc_header_t* header = (alloc_header_t*)((char*)cell->payload.ptr -
                                                    sizeof(alloc_header_t));
         header->refcount++;
-        debug("Retained array cell, refcount now %d", header->refcount);
+        trace(TRACE_RETAIN, CELL_ARRAY, header->refcount);
       }
       break;
     case CELL_POINTER:
@@ -118,14 +136,13 @@ void metal_release(cell_t* cell) {
 
   switch (cell->type) {
     case CELL_STRING:
+    case CELL_BIGINT:
     case CELL_OBJECT:
-    case CELL_CODE:
       if (!(cell->flags & CELL_FLAG_WEAK_REF)) {
         alloc_header_t* header = (alloc_header_t*)((char*)cell->payload.ptr -
                                                    sizeof(alloc_header_t));
         header->refcount--;
-        debug("Released cell type %d, refcount now %d", cell->type,
-              header->refcount);
+        trace(TRACE_RELEASE, cell->type, header->refcount);
         if (header->refcount == 0) {
           metal_free(cell->payload.ptr);
           cell->payload.ptr = NULL;
@@ -137,7 +154,7 @@ void metal_release(cell_t* cell) {
         alloc_header_t* header = (alloc_header_t*)((char*)cell->payload.ptr -
                                                    sizeof(alloc_header_t));
         header->refcount--;
-        debug("Released array cell, refcount now %d", header->refcount);
+        trace(TRACE_RELEASE, CELL_ARRAY, header->refcount);
         if (header->refcount == 0) {
           // Release all elements first
           array_data_t* data = (array_data_t*)cell->payload.ptr;
@@ -149,6 +166,24 @@ void metal_release(cell_t* cell) {
         }
       }
       break;
+    case CELL_CODE:
+      if (!(cell->flags & CELL_FLAG_WEAK_REF)) {
+        alloc_header_t* header = (alloc_header_t*)((char*)cell->payload.ptr -
+                                                   sizeof(alloc_header_t));
+        header->refcount--;
+        trace(TRACE_RELEASE, CELL_CODE, header->refcount);
+        if (header->refcount == 0) {
+          // Release literals and callees referenced by the code
+          code_data_t* data = (code_data_t*)cell->payload.ptr;
+          for (size_t i = 0; i < data->length; i++) {
+            metal_release(&data->instructions[i]);
+          }
+          metal_free(data->ir);  // Borrows its cells from the code
+          metal_free(cell->payload.ptr);
+          cell->payload.ptr = NULL;
+        }
+      }
+      break;
     case CELL_POINTER:
       // Pointers don't own the pointed-to memory
       break;
@@ -0,0 +1,208 @@
+#include "code.h"
+
+#include <stddef.h>
+
+#include "cell.h"
+#include "ir.h"
+#include "memory.h"
+#include "profile.h"
+#include "stack.h"
+#include "trace.h"
+
+// Code data management
+
+code_data_t* create_code_data(size_t length) {
+  size_t alloc_size = sizeof(code_data_t) + (length * sizeof(cell_t));
+  code_data_t* data = metal_alloc(alloc_size);
+  if (!data) {
+    trace(TRACE_CODE_CREATE_FAIL, length);
+    return NULL;
+  }
+  count_cell_alloc(CELL_CODE);
+
+  data->length = length;
+  data->ir = NULL;
+  trace(TRACE_CODE_CREATE, length);
+  return data;
+}
+
+// Cell creation for code
+
+cell_t new_code(code_data_t* data) {
+  cell_t cell = {0};
+  cell.type = CELL_CODE;
+  cell.payload.ptr = data;
+  return cell;
+}
+
+// Inner interpreter
+
+static void call_code(context_t* ctx, code_data_t* code) {
+  // Save the return address; the callee's EXIT restores it
+  return_push(ctx, new_pointer(ctx->ip));
+  ctx->ip = code->instructions;
+}
+
+void execute_threaded(context_t* ctx, code_data_t* code) {
+  // Run until the outermost definition returns. Nested calls push and pop
+  // above this depth, so natives may safely call execute() recursively.
+  const int base = ctx->return_stack_ptr;
+  call_code(ctx, code);
+
+  while (ctx->return_stack_ptr > base) {
+    const cell_t* instruction = ctx->ip++;
+
+    switch (instruction->type) {
+      case CELL_NATIVE:
+        instruction->payload.native(ctx);
+        break;
+      case CELL_CODE:
+        if (instruction->flags & CELL_FLAG_TAIL_CALL) {
+          // Nothing follows in this definition, so keep its return address
+          ctx->ip = ((code_data_t*)instruction->payload.ptr)->instructions;
+        } else {
+          call_code(ctx, instruction->payload.ptr);
+        }
+        break;
+      default:
+        // Anything else is a literal
+        data_push(ctx, *instruction);
+        break;
+    }
+  }
+}
+
+// The threaded loop again, reporting every call and return to the profiler.
+// Kept apart so the loop above has no profiling branch at all.
+static void execute_profiled_threaded(context_t* ctx, code_data_t* code) {
+  const int base = ctx->return_stack_ptr;
+  profile_enter_code(code);
+  call_code(ctx, code);
+
+  while (ctx->return_stack_ptr > base) {
+    const cell_t* instruction = ctx->ip++;
+
+    switch (instruction->type) {
+      case CELL_NATIVE: {
+        const native_func_t native = instruction->payload.native;
+        if (native == native_branch || native == native_zbranch) {
+          native(ctx);
+        } else if (native == native_exit) {
+          native(ctx);
+          profile_exit();
+        } else {
+          profile_enter_native(native);
+          native(ctx);
+          profile_exit();
+        }
+        break;
+      }
+      case CELL_CODE:
+        if (instruction->flags & CELL_FLAG_TAIL_CALL) {
+          // The callee returns for the caller, so it takes the caller's
+          // frame
+          profile_exit();
+          profile_enter_code(instruction->payload.ptr);
+          ctx->ip = ((code_data_t*)instruction->payload.ptr)->instructions;
+        } else {
+          profile_enter_code(instruction->payload.ptr);
+          call_code(ctx, instruction->payload.ptr);
+        }
+        break;
+      default:
+        data_push(ctx, *instruction);
+        break;
+    }
+  }
+}
+
+static void execute_profiled(context_t* ctx, const cell_t* definition) {
+  if (definition->type == CELL_NATIVE) {
+    profile_enter_native(definition->payload.native);
+    definition->payload.native(ctx);
+    profile_exit();
+    return;
+  }
+
+  if (definition->type != CELL_CODE) {
+    error("Cannot execute cell type %d", definition->type);
+    return;
+  }
+
+  if (register_engine_enabled) {
+    ir_execute(ctx, definition->payload.ptr);  // Reports its own calls
+  } else {
+    execute_profiled_threaded(ctx, definition->payload.ptr);
+  }
+}
+
+void execute(context_t* ctx, const cell_t* definition) {
+  if (profile_enabled) {
+    execute_profiled(ctx, definition);
+    return;
+  }
+
+  if (definition->type == CELL_NATIVE) {
+    definition->payload.native(ctx);
+    return;
+  }
+
+  if (definition->type != CELL_CODE) {
+    error("Cannot execute cell type %d", definition->type);
+    return;
+  }
+
+  if (register_engine_enabled) {
+    ir_execute(ctx, definition->payload.ptr);
+  } else {
+    execute_threaded(ctx, definition->payload.ptr);
+  }
+}
+
+bool is_true(const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_INT32:
+    case CELL_FIXED:
+      return cell->payload.i32 != 0;
+    case CELL_INT64:
+      return cell->payload.i64 != 0;
+    case CELL_FLOAT:
+      return cell->payload.f != 0.0;
+    case CELL_FLOAT32:
+      return cell->payload.f32 != 0.0f;
+    case CELL_NIL:
+    case CELL_NULL:
+    case CELL_EMPTY:
+    case CELL_UNDEFINED:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool pop_flag(context_t* ctx) {
+  cell_t cell = data_pop(ctx);
+  bool flag = is_true(&cell);
+  metal_release(&cell);
+  return flag;
+}
+
+// Threaded code primitives
+
+void native_exit(context_t* ctx) {
+  cell_t return_address = return_pop(ctx);
+  ctx->ip = return_address.payload.pointer;
+}
+
+void native_branch(context_t* ctx) {
+  // The offset cell follows the branch and is relative to itself
+  ctx->ip += ctx->ip->payload.i32;
+}
+
+void native_zbranch(context_t* ctx) {
+  if (pop_flag(ctx)) {
+    ctx->ip++;  // Skip the offset cell
+  } else {
+    ctx->ip += ctx->ip->payload.i32;
+  }
+}
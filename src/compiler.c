@@ -0,0 +1,673 @@
+#include "compiler.h"
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "code.h"
+#include "dictionary.h"
+#include "epoch.h"
+#include "math.h"
+#include "memory.h"
+#include "output.h"
+#include "parser.h"
+#include "trace.h"
+#include "util.h"
+
+#define MAX_CONTROL_DEPTH 32
+#define MAX_INLINE_CELLS 8
+
+typedef enum { CONTROL_IF, CONTROL_ELSE, CONTROL_BEGIN } control_kind_t;
+
+typedef struct {
+  control_kind_t kind;
+  size_t index;  // Offset cell to patch, or loop start for BEGIN
+} control_entry_t;
+
+// Definition being compiled
+static bool compiling = false;
+static char definition_name[32];
+static const char* definition_help;
+static cell_t* definition = NULL;
+static size_t definition_length = 0;
+static size_t definition_capacity = 0;
+
+// Words the definition links to, for relinking when they are redefined
+static link_site_t* definition_links = NULL;
+static uint32_t definition_link_count = 0;
+static uint32_t definition_link_capacity = 0;
+static uint32_t relink_count = 0;
+
+// Unresolved control flow
+static control_entry_t control_stack[MAX_CONTROL_DEPTH];
+static int control_depth = 0;
+
+// Compilation state
+
+bool is_compiling(void) { return compiling; }
+
+static void reset_compilation(void) {
+  metal_free(definition);
+  definition = NULL;
+  definition_length = 0;
+  definition_capacity = 0;
+  metal_free(definition_links);
+  definition_links = NULL;
+  definition_link_count = 0;
+  definition_link_capacity = 0;
+  control_depth = 0;
+  compiling = false;
+}
+
+void abort_compilation(void) {
+  if (!compiling) return;
+
+  trace(TRACE_COMPILE_ABORT, definition_length);
+  for (size_t i = 0; i < definition_length; i++) {
+    metal_release(&definition[i]);
+  }
+  reset_compilation();
+}
+
+// Code generation
+
+static size_t emit(cell_t cell) {
+  if (definition_length >= definition_capacity) {
+    size_t new_capacity = definition_capacity ? definition_capacity * 2 : 16;
+    cell_t* grown =
+        metal_realloc(definition, new_capacity * sizeof(cell_t));
+    if (!grown) return definition_length;
+    definition = grown;
+    definition_capacity = new_capacity;
+  }
+
+  definition[definition_length] = cell;
+  return definition_length++;
+}
+
+static size_t emit_native(native_func_t func) {
+  cell_t cell = {0};
+  cell.type = CELL_NATIVE;
+  cell.payload.native = func;
+  return emit(cell);
+}
+
+// Emit a branch primitive followed by its offset cell, returning the index of
+// the offset cell so it can be patched once the target is known
+static size_t emit_branch(native_func_t branch) {
+  emit_native(branch);
+  return emit(new_int32(0));
+}
+
+static void patch_branch(size_t offset_index, size_t target_index) {
+  definition[offset_index].payload.i32 =
+      (int32_t)target_index - (int32_t)offset_index;
+}
+
+void compile_literal(cell_t cell) { emit(cell); }
+
+// Small definitions are spliced into their callers, saving the return stack
+// traffic and dispatch of a call. Every call and inlined copy is recorded as
+// a link site, and redefining a word rebuilds the sites that name it (see
+// relink_dependents), so an inlined copy never goes stale.
+static bool can_inline(const code_data_t* code) {
+  const size_t body_length = code->length - 1;  // Without the final EXIT
+  if (body_length >= MAX_INLINE_CELLS) return false;
+
+  for (size_t i = 0; i < body_length; i++) {
+    const cell_t* instruction = &code->instructions[i];
+
+    // Recursive words and early EXITs need a real frame
+    if (instruction->type == CELL_CODE && instruction->payload.ptr == code) {
+      return false;
+    }
+    if (instruction->type == CELL_NATIVE &&
+        instruction->payload.native == native_exit) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Emit a call to, or an inlined copy of, a word into the code being
+// compiled, returning the cell count
+static uint32_t emit_link(const dictionary_entry_t* entry) {
+  const size_t start = definition_length;
+  if (entry->definition.type == CELL_CODE &&
+      can_inline(entry->definition.payload.ptr)) {
+    // Branch offsets are relative, and a branch to the callee's EXIT lands
+    // on whatever the caller compiles next
+    const code_data_t* code = entry->definition.payload.ptr;
+    for (size_t i = 0; i + 1 < code->length; i++) {
+      cell_t cell = code->instructions[i];
+      cell.flags &= ~CELL_FLAG_TAIL_CALL;  // Re-marked at the caller's ;
+      metal_retain(&cell);
+      emit(cell);
+    }
+    trace(TRACE_INLINE, get_entry_index(entry), definition_length - start);
+    return (uint32_t)(definition_length - start);
+  }
+
+  cell_t cell = entry->definition;
+  if (cell.type == CELL_NATIVE) {
+    cell.payload.native = learning_variant(cell.payload.native);
+  }
+  metal_retain(&cell);  // The compiled code now references the definition
+  emit(cell);
+  return 1;
+}
+
+void compile_word(const dictionary_entry_t* entry) {
+  if (definition_link_count == definition_link_capacity) {
+    const uint32_t capacity =
+        definition_link_capacity ? definition_link_capacity * 2 : 8;
+    link_site_t* grown =
+        metal_realloc(definition_links, capacity * sizeof(link_site_t));
+    if (!grown) return;
+    definition_links = grown;
+    definition_link_capacity = capacity;
+  }
+
+  link_site_t* link = &definition_links[definition_link_count++];
+  link->position = (uint32_t)definition_length;
+  link->entry = get_entry_index(entry);
+  link->length = emit_link(entry);
+}
+
+// Mark calls that are followed by EXIT, directly or through unconditional
+// branches, as tail calls that reuse the caller's return stack frame
+static void mark_tail_calls(code_data_t* code) {
+  for (size_t i = 0; i < code->length; i++) {
+    if (code->instructions[i].type != CELL_CODE) continue;
+
+    size_t next = i + 1;
+    for (size_t hops = 0; hops < code->length; hops++) {
+      const cell_t* instruction = &code->instructions[next];
+      if (instruction->type != CELL_NATIVE ||
+          instruction->payload.native != native_branch) {
+        break;
+      }
+      next = next + 1 + code->instructions[next + 1].payload.i32;
+    }
+
+    const cell_t* follower = &code->instructions[next];
+    if (follower->type == CELL_NATIVE &&
+        follower->payload.native == native_exit) {
+      code->instructions[i].flags |= CELL_FLAG_TAIL_CALL;
+    }
+  }
+}
+
+// Relinking. Redefining a word rebuilds every definition that links to it,
+// directly or through an inlined copy of another dependent, splicing fresh
+// code into each link site. Only affected definitions are touched.
+
+typedef enum : uint8_t {
+  RELINK_NONE,
+  RELINK_PENDING,  // Depends on the old word, not rebuilt yet
+  RELINK_ORDERED,
+} relink_state_t;
+
+typedef struct {
+  int old_index;  // Shadowed entry
+  int new_index;  // Its redefinition, which keeps calling the old one
+  relink_state_t* state;
+  int* order;  // Members, each after the members it inlines
+  int member_count;
+  cell_t* replaced;  // Previous definitions of the members, by order
+  cell_t* rebuilt;   // New definitions, published once all are built
+} relink_t;
+
+static void collect_dependents(relink_t* r, int index) {
+  uint32_t count;
+  const int* dependents = get_dependents(index, &count);
+  for (uint32_t i = 0; i < count; i++) {
+    const int dependent = dependents[i];
+    if (dependent == r->new_index || r->state[dependent]) continue;
+    r->state[dependent] = RELINK_PENDING;
+    collect_dependents(r, dependent);
+  }
+}
+
+static void order_members(relink_t* r, int index) {
+  r->state[index] = RELINK_ORDERED;
+  const dictionary_entry_t* entry = get_dictionary_entry(index);
+  for (uint32_t i = 0; i < entry->link_count; i++) {
+    if (r->state[entry->links[i].entry] == RELINK_PENDING) {
+      order_members(r, entry->links[i].entry);
+    }
+  }
+  r->order[r->member_count++] = index;
+}
+
+// The entry a link site should reach: members rebuilt earlier are not
+// published yet, so their new code is substituted into a copy
+static const dictionary_entry_t* link_target(const relink_t* r, int member,
+                                             int target,
+                                             dictionary_entry_t* copy) {
+  const dictionary_entry_t* entry = get_dictionary_entry(target);
+  for (int m = 0; m < member; m++) {
+    if (r->order[m] == target && r->rebuilt[m].type == CELL_CODE) {
+      *copy = *entry;
+      copy->definition = r->rebuilt[m];
+      return copy;
+    }
+  }
+  return entry;
+}
+
+// Recompile one member into the definition buffer, re-emitting its link
+// sites and copying everything else
+static void rebuild_member(relink_t* r, int member) {
+  dictionary_entry_t* entry = get_defined_entry(r->order[member]);
+  const code_data_t* old = entry->definition.payload.ptr;
+  const uint32_t link_count = entry->link_count;
+
+  size_t* moved = metal_alloc((old->length + 1) * sizeof(size_t));
+  size_t* branches = metal_alloc(old->length * sizeof(size_t));
+  link_site_t* links = metal_alloc(link_count * sizeof(link_site_t));
+  if (!moved || !branches || !links) {
+    metal_free(moved);
+    metal_free(branches);
+    metal_free(links);
+    r->replaced[member] = r->rebuilt[member] = (cell_t){0};
+    return;
+  }
+
+  definition_length = 0;
+  size_t branch_count = 0;
+  size_t mapped = SIZE_MAX;  // Last old position given a new one
+  uint32_t site = 0;
+  for (size_t i = 0; i < old->length;) {
+    if (mapped != i) {
+      moved[i] = definition_length;
+      mapped = i;
+    }
+
+    if (site < link_count && entry->links[site].position == i) {
+      int target = entry->links[site].entry;
+      if (target == r->old_index) target = r->new_index;
+      links[site].position = (uint32_t)definition_length;
+      links[site].entry = target;
+      dictionary_entry_t copy;
+      links[site].length = emit_link(link_target(r, member, target, &copy));
+      i += entry->links[site++].length;
+      continue;
+    }
+
+    cell_t cell = old->instructions[i];
+    cell.flags &= ~CELL_FLAG_TAIL_CALL;
+    metal_retain(&cell);
+    emit(cell);
+    if (cell.type == CELL_NATIVE && (cell.payload.native == native_branch ||
+                                     cell.payload.native == native_zbranch)) {
+      branches[branch_count++] = i;
+      moved[++i] = definition_length;
+      mapped = i;
+      emit(old->instructions[i]);  // Offset, patched below
+    }
+    i++;
+  }
+  moved[old->length] = definition_length;
+
+  // The definition's own branches keep their targets
+  for (size_t b = 0; b < branch_count; b++) {
+    const size_t offset = branches[b] + 1;
+    const size_t target = offset + old->instructions[offset].payload.i32;
+    definition[moved[offset]].payload.i32 =
+        (int32_t)moved[target] - (int32_t)moved[offset];
+  }
+  metal_free(moved);
+  metal_free(branches);
+
+  code_data_t* data = create_code_data(definition_length);
+  if (!data) {
+    for (size_t i = 0; i < definition_length; i++) {
+      metal_release(&definition[i]);
+    }
+    metal_free(links);
+    r->replaced[member] = r->rebuilt[member] = (cell_t){0};
+    return;
+  }
+  memcpy(data->instructions, definition, definition_length * sizeof(cell_t));
+  for (size_t i = 0; i < data->length; i++) {
+    cell_t* instruction = &data->instructions[i];
+    if (instruction->type == CELL_CODE && instruction->payload.ptr == old &&
+        (instruction->flags & CELL_FLAG_WEAK_REF)) {
+      instruction->payload.ptr = data;  // RECURSE
+    }
+  }
+  mark_tail_calls(data);
+
+  r->replaced[member] = entry->definition;
+  r->rebuilt[member] = new_code(data);
+  set_word_links(r->order[member], links, link_count);
+  trace(TRACE_RELINK, r->order[member], data->length);
+}
+
+// Calls between members that depend on each other still reach code rebuilt
+// after the caller; point them at the new definitions
+static void patch_member_calls(relink_t* r) {
+  for (int m = 0; m < r->member_count; m++) {
+    if (r->rebuilt[m].type != CELL_CODE) continue;
+    code_data_t* code = r->rebuilt[m].payload.ptr;
+
+    for (size_t i = 0; i < code->length; i++) {
+      cell_t* instruction = &code->instructions[i];
+      if (instruction->type != CELL_CODE ||
+          (instruction->flags & CELL_FLAG_WEAK_REF)) {
+        continue;
+      }
+      for (int k = 0; k < r->member_count; k++) {
+        if (r->rebuilt[k].type == CELL_CODE &&
+            instruction->payload.ptr == r->replaced[k].payload.ptr) {
+          cell_t* current = &r->rebuilt[k];
+          metal_retain(current);
+          metal_release(instruction);
+          instruction->payload.ptr = current->payload.ptr;
+          break;
+        }
+      }
+    }
+  }
+}
+
+static void relink_members(relink_t* r, int size) {
+  memset(r->state, RELINK_NONE, size * sizeof(relink_state_t));
+  collect_dependents(r, r->old_index);
+  for (int i = 0; i < size; i++) {
+    if (r->state[i] == RELINK_PENDING) order_members(r, i);
+  }
+  if (r->member_count == 0) return;
+
+  for (int m = 0; m < r->member_count; m++) rebuild_member(r, m);
+  patch_member_calls(r);
+
+  // Only the code pointer changes, so readers see either the old code or
+  // the new, finished code. Releasing the old code is not synchronised
+  // with other contexts running it (see epoch.h).
+  for (int m = 0; m < r->member_count; m++) {
+    if (r->rebuilt[m].type != CELL_CODE) continue;
+    cell_t* definition = &get_defined_entry(r->order[m])->definition;
+    atomic_store_explicit((void* _Atomic*)&definition->payload.ptr,
+                          r->rebuilt[m].payload.ptr, memory_order_release);
+    epoch_retire_cell(r->replaced[m]);
+  }
+
+  relink_count++;
+  trace(TRACE_RELINK_DONE, r->member_count, r->new_index);
+}
+
+// Rebuild the dependents of a redefined word so they reach the new one
+static void relink_dependents(int old_index, int new_index) {
+  const int size = get_dictionary_size();
+  relink_t r = {.old_index = old_index, .new_index = new_index};
+  r.state = metal_alloc(size * sizeof(relink_state_t));
+  r.order = metal_alloc(size * sizeof(int));
+  r.replaced = metal_alloc(size * sizeof(cell_t));
+  r.rebuilt = metal_alloc(size * sizeof(cell_t));
+  if (r.state && r.order && r.replaced && r.rebuilt) relink_members(&r, size);
+
+  metal_free(r.state);
+  metal_free(r.order);
+  metal_free(r.replaced);
+  metal_free(r.rebuilt);
+}
+
+uint32_t get_relink_count(void) { return relink_count; }
+
+// Control flow stack
+
+static void control_push(control_kind_t kind, size_t index) {
+  if (control_depth >= MAX_CONTROL_DEPTH) {
+    error("Control structures nested too deeply");
+    return;
+  }
+
+  control_stack[control_depth].kind = kind;
+  control_stack[control_depth].index = index;
+  control_depth++;
+}
+
+static control_entry_t control_pop(const char* word, control_kind_t expected,
+                                   control_kind_t alternate) {
+  if (control_depth <= 0) {
+    error("%s : unmatched control structure", word);
+  }
+
+  control_entry_t entry = control_stack[--control_depth];
+  if (entry.kind != expected && entry.kind != alternate) {
+    error("%s : unmatched control structure", word);
+  }
+
+  return entry;
+}
+
+static void require_compiling(const char* word) {
+  if (!compiling) {
+    error("%s : compile-only word", word);
+  }
+}
+
+// Defining words
+
+static void native_colon(context_t* ctx) {
+  if (compiling) {
+    error(": : already compiling '%s'", definition_name);
+    return;
+  }
+
+  if (!ctx->input_pos) {
+    error(": : missing name");
+    return;
+  }
+
+  token_t name;
+  if (parse_next_token(&ctx->input_pos, &name) != TOKEN_WORD) {
+    error(": : missing name");
+    return;
+  }
+
+  if (name.length >= sizeof(definition_name)) {
+    error(": : name too long: %.*s", (int)name.length, name.start);
+    return;
+  }
+
+  memcpy(definition_name, name.start, name.length);
+  definition_name[name.length] = '\0';
+  definition_help = "( -- ) Compiled definition";
+
+  // A leading stack comment becomes the word's help text
+  skip_whitespace(&ctx->input_pos);
+  if (ctx->input_pos[0] == '(' && ctx->input_pos[1] &&
+      isspace((unsigned char)ctx->input_pos[1])) {
+    const char* start = ctx->input_pos;
+    const char* end = strchr(start, ')');
+    if (end) {
+      size_t length = end - start + 1;
+      char* help = metal_alloc(length + 1);
+      if (help) {
+        memcpy(help, start, length);
+        help[length] = '\0';
+        definition_help = help;
+      }
+      ctx->input_pos = end + 1;
+    }
+  }
+
+  compiling = true;
+  trace(TRACE_COMPILE_START, get_dictionary_size());
+}
+
+static void native_semicolon([[maybe_unused]] context_t* ctx) {
+  require_compiling(";");
+
+  if (control_depth > 0) {
+    error("; : unresolved control structure in '%s'", definition_name);
+    return;
+  }
+
+  emit_native(native_exit);
+
+  code_data_t* data = create_code_data(definition_length);
+  if (!data) {
+    abort_compilation();
+    return;
+  }
+
+  // Ownership of the compiled cells moves into the code data
+  memcpy(data->instructions, definition, definition_length * sizeof(cell_t));
+
+  // Resolve RECURSE placeholders; the self-reference is weak so the code
+  // does not keep itself alive
+  for (size_t i = 0; i < data->length; i++) {
+    cell_t* instruction = &data->instructions[i];
+    if (instruction->type == CELL_CODE && !instruction->payload.ptr) {
+      instruction->payload.ptr = data;
+    }
+  }
+  mark_tail_calls(data);
+
+  const dictionary_entry_t* shadowed = find_current_word(definition_name);
+  const int shadowed_index = shadowed ? get_entry_index(shadowed) : -1;
+  add_code_word(definition_name, new_code(data), definition_help);
+  trace(TRACE_COMPILE_END, get_dictionary_size() - 1, data->length);
+
+  // The entry takes over the link sites
+  const int index = get_dictionary_size() - 1;
+  set_word_links(index, definition_links, definition_link_count);
+  definition_links = NULL;
+  definition_link_count = 0;
+  definition_link_capacity = 0;
+
+  uint32_t dependent_count = 0;
+  if (shadowed_index >= 0) get_dependents(shadowed_index, &dependent_count);
+  if (dependent_count > 0) relink_dependents(shadowed_index, index);
+  reset_compilation();
+}
+
+static void native_recurse([[maybe_unused]] context_t* ctx) {
+  require_compiling("RECURSE");
+
+  cell_t self = {0};
+  self.type = CELL_CODE;
+  self.flags = CELL_FLAG_WEAK_REF;
+  self.payload.ptr = NULL;  // Patched by ;
+  emit(self);
+}
+
+// Control flow words
+
+static void native_if([[maybe_unused]] context_t* ctx) {
+  require_compiling("IF");
+  control_push(CONTROL_IF, emit_branch(native_zbranch));
+}
+
+static void native_else([[maybe_unused]] context_t* ctx) {
+  require_compiling("ELSE");
+  control_entry_t entry = control_pop("ELSE", CONTROL_IF, CONTROL_IF);
+  size_t offset_index = emit_branch(native_branch);
+  patch_branch(entry.index, definition_length);
+  control_push(CONTROL_ELSE, offset_index);
+}
+
+static void native_then([[maybe_unused]] context_t* ctx) {
+  require_compiling("THEN");
+  control_entry_t entry = control_pop("THEN", CONTROL_IF, CONTROL_ELSE);
+  patch_branch(entry.index, definition_length);
+}
+
+static void native_begin([[maybe_unused]] context_t* ctx) {
+  require_compiling("BEGIN");
+  control_push(CONTROL_BEGIN, definition_length);
+}
+
+static void native_until([[maybe_unused]] context_t* ctx) {
+  require_compiling("UNTIL");
+  control_entry_t entry = control_pop("UNTIL", CONTROL_BEGIN, CONTROL_BEGIN);
+  patch_branch(emit_branch(native_zbranch), entry.index);
+}
+
+static void native_again([[maybe_unused]] context_t* ctx) {
+  require_compiling("AGAIN");
+  control_entry_t entry = control_pop("AGAIN", CONTROL_BEGIN, CONTROL_BEGIN);
+  patch_branch(emit_branch(native_branch), entry.index);
+}
+
+// Decompiler
+
+static void native_see(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) != TOKEN_WORD) {
+    error("SEE : missing word name");
+    return;
+  }
+
+  const dictionary_entry_t* entry = find_word_span(name.start, name.length);
+  if (!entry) {
+    error("SEE : unknown word %.*s", (int)name.length, name.start);
+    return;
+  }
+  if (entry->definition.type != CELL_CODE) {
+    output_format("%s is a native word\n", entry->name);
+    return;
+  }
+
+  const code_data_t* code = entry->definition.payload.ptr;
+  output_format(": %s %s\n", entry->name, entry->help);
+
+  for (size_t i = 0; i < code->length; i++) {
+    const cell_t* instruction = &code->instructions[i];
+    output_format("%4zu  ", i);
+
+    if (instruction->type == CELL_NATIVE) {
+      native_func_t native = instruction->payload.native;
+      if (native == native_branch || native == native_zbranch) {
+        i++;
+        output_format("%s -> %zu",
+                      native == native_branch ? "BRANCH" : "0BRANCH",
+                      i + code->instructions[i].payload.i32);
+      } else {
+        const char* word = variant_name(native);
+        if (!word) word = find_word_name(instruction);
+        output_format("%s", word ? word : "<native>");
+      }
+    } else if (instruction->type == CELL_CODE) {
+      const char* word = instruction->payload.ptr == code
+                             ? "RECURSE"
+                             : find_word_name(instruction);
+      output_format("%s", word ? word : "<code>");
+      if (instruction->flags & CELL_FLAG_TAIL_CALL) output_text(" (tail call)");
+    } else {
+      print_cell(instruction);
+    }
+    output_char('\n');
+  }
+}
+
+// Compiler words
+static const dictionary_entry_t compiler_entries[] = {
+    // Defining words
+    DEFINING_WORD(":", native_colon, "( -- ) Start a new definition"),
+    IMMEDIATE_WORD(";", native_semicolon, "( -- ) End the definition"),
+    IMMEDIATE_WORD("RECURSE", native_recurse,
+                   "( -- ) Call the definition being compiled"),
+    NATIVE_WORD("EXIT", native_exit,
+                "( -- ) Return from the current definition"),
+
+    // Control flow
+    IMMEDIATE_WORD("IF", native_if, "( flag -- ) Run if flag is true"),
+    IMMEDIATE_WORD("ELSE", native_else, "( -- ) Run if flag was false"),
+    IMMEDIATE_WORD("THEN", native_then, "( -- ) End IF or IF ELSE"),
+    IMMEDIATE_WORD("BEGIN", native_begin, "( -- ) Start a loop"),
+    IMMEDIATE_WORD("UNTIL", native_until,
+                   "( flag -- ) Loop back to BEGIN until flag is true"),
+    IMMEDIATE_WORD("AGAIN", native_again,
+                   "( -- ) Loop back to BEGIN unconditionally"),
+
+    // Inspection
+    NATIVE_WORD("SEE", native_see,
+                "( \"name\" -- ) Show the compiled code of a word"),
+};
+const word_table_t compiler_words = WORD_TABLE(compiler_entries);
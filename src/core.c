@@ -10,7 +10,7 @@
 
 // Stack manipulation words
 
-static void native_dup(context_t* ctx) {
+void native_dup(context_t* ctx) {
   if (ctx->data_stack_ptr <= 0) {
     error("DUP: stack underflow");
     return;
@@ -20,7 +20,7 @@ static void native_dup(context_t* ctx) {
   data_push(ctx, top);
 }
 
-static void native_drop(context_t* ctx) {
+void native_drop(context_t* ctx) {
   if (ctx->data_stack_ptr <= 0) {
     error("DROP: stack underflow");
     return;
@@ -30,7 +30,7 @@ static void native_drop(context_t* ctx) {
   metal_release(&cell);
 }
 
-static void native_swap(context_t* ctx) {
+void native_swap(context_t* ctx) {
   if (ctx->data_stack_ptr < 2) {
     error("SWAP: insufficient stack");
     return;
@@ -46,33 +46,9 @@ static void native_swap(context_t* ctx) {
   metal_release(&b);
 }
 
-// Arithmetic words
-
-static void native_add(context_t* ctx) {
-  if (ctx->data_stack_ptr < 2) {
-    error("+ : insufficient stack");
-    return;
-  }
-
-  cell_t b = data_pop(ctx);
-  cell_t a = data_pop(ctx);
-
-  // Simple integer addition for now
-  if (a.type == CELL_INT32 && b.type == CELL_INT32) {
-    data_push(ctx, new_int32(a.payload.i32 + b.payload.i32));
-  } else {
-    error("+ : type mismatch");
-    data_push(ctx, a);
-    data_push(ctx, b);
-  }
-
-  metal_release(&a);
-  metal_release(&b);
-}
-
 // I/O words
 
-static void native_print(context_t* ctx) {
+void native_print(context_t* ctx) {
   if (ctx->data_stack_ptr <= 0) {
     error("PRINT: stack underflow");
     return;
@@ -85,9 +61,9 @@ static void native_print(context_t* ctx) {
 
 // Array words
 
-static void native_nil(context_t* ctx) { data_push(ctx, new_nil()); }
+void native_nil(context_t* ctx) { data_push(ctx, new_nil()); }
 
-static void native_comma(context_t* ctx) {
+void native_comma(context_t* ctx) {
   if (ctx->data_stack_ptr < 2) {
     error(", : insufficient stack (need array and element)");
     return;
@@ -150,7 +126,7 @@ static void native_comma(context_t* ctx) {
   metal_release(&element);  // We retained it above, so release our reference
 }
 
-static void native_length(context_t* ctx) {
+void native_length(context_t* ctx) {
   if (ctx->data_stack_ptr < 1) {
     error("LENGTH: stack underflow");
     return;
@@ -172,7 +148,7 @@ static void native_length(context_t* ctx) {
   metal_release(&array_cell);
 }
 
-static void native_index(context_t* ctx) {
+void native_index(context_t* ctx) {
   if (ctx->data_stack_ptr < 2) {
     error("INDEX: insufficient stack (need array and index)");
     return;
@@ -219,7 +195,7 @@ static void native_index(context_t* ctx) {
   metal_release(&index_cell);
 }
 
-static void native_fetch(context_t* ctx) {
+void native_fetch(context_t* ctx) {
   if (ctx->data_stack_ptr < 1) {
     error("@ : stack underflow");
     return;
@@ -247,7 +223,7 @@ static void native_fetch(context_t* ctx) {
   metal_release(&pointer_cell);
 }
 
-static void native_store(context_t* ctx) {
+void native_store(context_t* ctx) {
   if (ctx->data_stack_ptr < 2) {
     error("! : insufficient stack (need pointer and value)");
     return;
@@ -290,30 +266,27 @@ static void native_paren_comment(context_t* ctx) {
   metal_free(comment);
 }
 
-// Register all core words
-void add_core_words(void) {
-  // Stack manipulation
-  add_native_word("DUP", native_dup, "( a -- a a ) Duplicate top of stack");
-  add_native_word("DROP", native_drop, "( a -- ) Remove top of stack");
-  add_native_word("SWAP", native_swap,
-                  "( a b -- b a ) Swap top two stack items");
-  // Arithmetic
-  add_native_word("+", native_add, "( a b -- c ) Add two numbers");
-
-  // I/O
-  add_native_word("PRINT", native_print, "( a -- ) Print value to output");
-
-  // Array operations
-  add_native_word("[]", native_nil, "( -- array ) Create empty array");
-  add_native_word(",", native_comma,
-                  "( array item -- array ) Append item to array");
-  add_native_word("LENGTH", native_length, "( array -- n ) Get array length");
-  add_native_word("INDEX", native_index,
-                  "( array n -- ptr ) Get pointer to array element");
-  add_native_word("@", native_fetch,
-                  "( ptr -- value ) Fetch value from pointer");
-  add_native_word("!", native_store, "( ptr value -- ) Store value at pointer");
-
-  add_native_word("(", native_paren_comment,
-                  "( comment -- ) Parenthesis comment until )");
-}
\ No newline at end of file
+// Core words
+static const dictionary_entry_t core_entries[] = {
+    // Stack manipulation
+    NATIVE_WORD("DUP", native_dup, "( a -- a a ) Duplicate top of stack"),
+    NATIVE_WORD("DROP", native_drop, "( a -- ) Remove top of stack"),
+    NATIVE_WORD("SWAP", native_swap, "( a b -- b a ) Swap top two stack items"),
+
+    // I/O
+    NATIVE_WORD("PRINT", native_print, "( a -- ) Print value to output"),
+
+    // Array operations
+    NATIVE_WORD("[]", native_nil, "( -- array ) Create empty array"),
+    NATIVE_WORD(",", native_comma,
+                "( array item -- array ) Append item to array"),
+    NATIVE_WORD("LENGTH", native_length, "( array -- n ) Get array length"),
+    NATIVE_WORD("INDEX", native_index,
+                "( array n -- ptr ) Get pointer to array element"),
+    NATIVE_WORD("@", native_fetch, "( ptr -- value ) Fetch value from pointer"),
+    NATIVE_WORD("!", native_store, "( ptr value -- ) Store value at pointer"),
+
+    IMMEDIATE_WORD("(", native_paren_comment,
+                   "( comment -- ) Parenthesis comment until )"),
+};
+const word_table_t core_words = WORD_TABLE(core_entries);
@@ -1,62 +1,536 @@
 #include "dictionary.h"
 
 #include <ctype.h>
+#include <stdatomic.h>
 #include <string.h>
 
-#include "debug.h"
-#include "util.h"
+#include "epoch.h"
+#include "memory.h"
+#include "trace.h"
 
-// Dictionary storage
-#define MAX_DICT_ENTRIES 256
-static dictionary_entry_t dictionary[MAX_DICT_ENTRIES];
-static int dict_size = 0;
+// Dictionary storage. Built-in words stay in their modules' const tables;
+// words defined at run time follow them in index order, in blocks that
+// never move so entry pointers stay valid as the dictionary grows.
+//
+// Other contexts look words up without locking (see epoch.h). A new entry
+// is filled in before the count that covers it is published, arrays that
+// grow are copied and the old ones retired, and forgotten entries are
+// retired rather than freed.
+#define ENTRY_BLOCK_SIZE 64
+static const word_table_t* const* builtin_tables;
+static int builtin_table_count;
+static int builtin_count;
+static dictionary_entry_t** _Atomic blocks;
+static int block_count;
+static _Atomic int defined_count;
+static bool vacated;  // Forgotten slots readers may still be looking at
+
+// Names of defined words, packed into chunks. Entries are only ever
+// forgotten newest first, so the arena is a stack.
+#define NAME_CHUNK_SIZE 1024
+typedef struct name_chunk {
+  struct name_chunk* previous;
+  size_t used;
+  char text[NAME_CHUNK_SIZE];
+} name_chunk_t;
+static name_chunk_t* names;
+
+// Entries whose code links to each entry
+typedef struct {
+  int* entries;
+  uint32_t count;
+  uint32_t capacity;
+} dependents_t;
+
+// Per-entry state by index. Lookups only follow the chains and compare
+// hashes, so the entries themselves (help, links and all) stay cold.
+static uint32_t* _Atomic hashes;
+static int* _Atomic chains;  // Next older entry in the same bucket, or -1
+static dependents_t* dependents;  // Only used by the updater
+static int capacity;
+
+// Each wordlist hashes its words into buckets of newest-first chains
+// through the entries. FORTH holds the built-ins; a VOCABULARY word owns
+// the wordlist it selects, which goes when the word is forgotten.
+#define WORDLIST_BUCKETS 64
+typedef struct {
+  int owner;  // Entry of the VOCABULARY word, or -1
+  _Atomic int heads[WORDLIST_BUCKETS];
+} wordlist_t;
+static wordlist_t* _Atomic wordlists[MAX_WORDLISTS];
+static _Atomic int wordlist_count;
+
+// Lookups go through the search order, first to last; new words go into
+// the current wordlist
+static _Atomic int search_order[MAX_SEARCH_ORDER];
+static _Atomic int search_depth;
+static int current_wordlist;
+
+// Case-insensitive 32-bit FNV-1a of a name
+static uint32_t name_hash(const char* name, size_t length) {
+  uint32_t hash = 0x811c9dc5;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)tolower((unsigned char)name[i]);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+// The nth word defined at run time
+static dictionary_entry_t* defined_at(int n) {
+  dictionary_entry_t** const published =
+      atomic_load_explicit(&blocks, memory_order_acquire);
+  return &published[n / ENTRY_BLOCK_SIZE][n % ENTRY_BLOCK_SIZE];
+}
+
+static const dictionary_entry_t* entry_at(int index) {
+  if (index >= builtin_count) return defined_at(index - builtin_count);
+  for (int i = 0; i < builtin_table_count; i++) {
+    if (index < builtin_tables[i]->count) {
+      return &builtin_tables[i]->entries[index];
+    }
+    index -= builtin_tables[i]->count;
+  }
+  return NULL;
+}
+
+// Arrays readers may be scanning grow into a copy; the caller publishes it
+// and retires the original
+static void* grown_copy(const void* array, size_t used, size_t size) {
+  void* copy = metal_alloc(size);
+  if (copy && used) memcpy(copy, array, used);
+  return copy;
+}
+
+// Room for one more entry in every index-ordered array
+static bool reserve_entry(void) {
+  const int size = get_dictionary_size();
+  if (size == capacity) {
+    const int grown = capacity * 2;
+    dependents_t* new_dependents =
+        metal_realloc(dependents, grown * sizeof(dependents_t));
+    if (!new_dependents) return false;
+    dependents = new_dependents;
+    memset(dependents + capacity, 0,
+           (grown - capacity) * sizeof(dependents_t));
+    uint32_t* old_hashes = atomic_load(&hashes);
+    uint32_t* new_hashes = grown_copy(old_hashes, size * sizeof(uint32_t),
+                                      grown * sizeof(uint32_t));
+    int* old_chains = atomic_load(&chains);
+    int* new_chains =
+        grown_copy(old_chains, size * sizeof(int), grown * sizeof(int));
+    if (!new_hashes || !new_chains) {
+      metal_free(new_hashes);
+      metal_free(new_chains);
+      return false;
+    }
+    atomic_store_explicit(&hashes, new_hashes, memory_order_release);
+    atomic_store_explicit(&chains, new_chains, memory_order_release);
+    epoch_retire(old_hashes);
+    epoch_retire(old_chains);
+    capacity = grown;
+  }
+
+  if (size - builtin_count == block_count * ENTRY_BLOCK_SIZE) {
+    dictionary_entry_t* block =
+        metal_alloc(ENTRY_BLOCK_SIZE * sizeof(dictionary_entry_t));
+    if (!block) return false;
+    dictionary_entry_t** old_blocks = atomic_load(&blocks);
+    dictionary_entry_t** new_blocks =
+        grown_copy(old_blocks, block_count * sizeof(block),
+                   (block_count + 1) * sizeof(block));
+    if (!new_blocks) {
+      metal_free(block);
+      return false;
+    }
+    new_blocks[block_count++] = block;
+    atomic_store_explicit(&blocks, new_blocks, memory_order_release);
+    epoch_retire(old_blocks);
+  }
+  return true;
+}
+
+static char* push_name(const char* name, size_t length) {
+  if (!names || names->used + length + 1 > NAME_CHUNK_SIZE) {
+    name_chunk_t* chunk = metal_alloc(sizeof(name_chunk_t));
+    if (!chunk) return NULL;
+    chunk->previous = names;
+    chunk->used = 0;
+    names = chunk;
+  }
+  char* copy = &names->text[names->used];
+  memcpy(copy, name, length);
+  copy[length] = '\0';
+  names->used += length + 1;
+  return copy;
+}
+
+// Release the newest name, and its chunk once that is empty
+static void pop_name(const char* name) {
+  names->used = (size_t)(name - names->text);
+  if (names->used == 0) {
+    name_chunk_t* previous = names->previous;
+    epoch_retire(names);
+    names = previous;
+  }
+}
+
+// Put an entry at the head of its bucket; readers see it once the head is
+// published
+static void link_entry(int index, int wordlist, uint32_t hash) {
+  _Atomic int* head =
+      &atomic_load(&wordlists[wordlist])->heads[hash % WORDLIST_BUCKETS];
+  hashes[index] = hash;
+  chains[index] = atomic_load_explicit(head, memory_order_relaxed);
+  atomic_store_explicit(head, index, memory_order_release);
+}
+
+// Built-in words a tree-shaken build left out have no native
+static bool is_present(const dictionary_entry_t* entry) {
+  return entry->definition.type != CELL_NATIVE ||
+         entry->definition.payload.native;
+}
 
 // Dictionary management
 
-void init_dictionary(void) {
-  dict_size = 0;
-  memset(dictionary, 0, sizeof(dictionary));
-  debug("Dictionary initialized");
+void init_dictionary(const word_table_t* const* tables, int table_count) {
+  builtin_tables = tables;
+  builtin_table_count = table_count;
+  builtin_count = 0;
+  for (int i = 0; i < table_count; i++) builtin_count += tables[i]->count;
+
+  capacity = builtin_count + ENTRY_BLOCK_SIZE;
+  atomic_store(&hashes, metal_alloc(capacity * sizeof(uint32_t)));
+  atomic_store(&chains, metal_alloc(capacity * sizeof(int)));
+  dependents = metal_alloc(capacity * sizeof(dependents_t));
+  memset(dependents, 0, capacity * sizeof(dependents_t));
+  atomic_store(&defined_count, 0);
+
+  atomic_store(&wordlist_count, 0);
+  create_wordlist(-1);  // FORTH
+  search_order[0] = FORTH_WORDLIST;
+  atomic_store(&search_depth, 1);
+  current_wordlist = FORTH_WORDLIST;
+
+  // Absent built-ins are left out of the chains, so lookups never see them
+  for (int i = 0; i < builtin_count; i++) {
+    const dictionary_entry_t* entry = entry_at(i);
+    if (entry->flags & WORD_FLAG_VOCABULARY) create_wordlist(i);
+    if (!is_present(entry)) continue;
+    link_entry(i, entry->wordlist, name_hash(entry->name, strlen(entry->name)));
+  }
+  trace(TRACE_DICTIONARY_INIT, builtin_count);
 }
 
-void add_native_word(const char* name, native_func_t func, const char* help) {
-  if (dict_size >= MAX_DICT_ENTRIES) {
-    error("Dictionary full");
+void add_code_word(const char* name, cell_t code, const char* help) {
+  // The dictionary takes over the caller's reference to the code
+  if (vacated) {
+    epoch_synchronize();  // Before reusing what readers saw forgotten
+    vacated = false;
+  }
+
+  size_t length = strlen(name);
+  if (length > MAX_NAME_LENGTH) length = MAX_NAME_LENGTH;
+  char* copy = reserve_entry() ? push_name(name, length) : NULL;
+  if (!copy) {
+    error("Out of memory");
     return;
   }
 
-  strncpy(dictionary[dict_size].name, name, 31);
-  dictionary[dict_size].name[31] = '\0';
+  const int index = get_dictionary_size();
+  *defined_at(index - builtin_count) =
+      (dictionary_entry_t){.name = copy,
+                           .definition = code,
+                           .help = help,
+                           .wordlist = (uint8_t)current_wordlist};
+  atomic_store_explicit(&defined_count, index - builtin_count + 1,
+                        memory_order_release);
+  link_entry(index, current_wordlist, name_hash(copy, length));
+  trace(TRACE_WORD_ADD, index);
+}
+
+const dictionary_entry_t* find_word(const char* name) {
+  return find_word_span(name, strlen(name));
+}
+
+// Case-insensitive match of an entry name against a source span
+static bool name_matches(const char* entry_name, const char* name,
+                         size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (tolower((unsigned char)entry_name[i]) !=
+        tolower((unsigned char)name[i])) {
+      return false;  // Also stops at the end of a shorter entry name
+    }
+  }
+  return entry_name[length] == '\0';
+}
+
+// Newest entry of a wordlist below an index with the given name, or -1
+static int find_below(int wordlist, int below, const char* name,
+                      size_t length, uint32_t hash) {
+  // The head is published last, so the arrays loaded after it cover it
+  const wordlist_t* list = atomic_load(&wordlists[wordlist]);
+  int index = atomic_load_explicit(&list->heads[hash % WORDLIST_BUCKETS],
+                                   memory_order_acquire);
+  const uint32_t* published_hashes =
+      atomic_load_explicit(&hashes, memory_order_acquire);
+  const int* published_chains =
+      atomic_load_explicit(&chains, memory_order_acquire);
+  for (; index >= 0; index = published_chains[index]) {
+    if (index < below && published_hashes[index] == hash &&
+        name_matches(entry_at(index)->name, name, length)) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+// Newest entry with the given name in the first wordlist of the search
+// order that has one, or -1. FORTH is the root: searched last even when the
+// order leaves it out, so ONLY and FORTH can always be found.
+static int find_index(const char* name, size_t length) {
+  if (length > MAX_NAME_LENGTH) return -1;
+
+  const uint32_t hash = name_hash(name, length);
+  const int size = get_dictionary_size();
+  const int depth = atomic_load(&search_depth);
+  bool searched_forth = false;
+  for (int i = 0; i < depth; i++) {
+    const int wordlist = atomic_load(&search_order[i]);
+    const int index = find_below(wordlist, size, name, length, hash);
+    if (index >= 0) return index;
+    searched_forth |= wordlist == FORTH_WORDLIST;
+  }
+  return searched_forth
+             ? -1
+             : find_below(FORTH_WORDLIST, size, name, length, hash);
+}
+
+const dictionary_entry_t* find_word_span(const char* name, size_t length) {
+  const int index = find_index(name, length);
+  if (index < 0) {
+    trace(TRACE_WORD_MISSING, length);
+    return NULL;
+  }
+  trace(TRACE_WORD_FOUND, index);
+  return entry_at(index);
+}
+
+const dictionary_entry_t* find_current_word(const char* name) {
+  const size_t length = strlen(name);
+  if (length > MAX_NAME_LENGTH) return NULL;
+
+  const int index = find_below(current_wordlist, get_dictionary_size(), name,
+                               length, name_hash(name, length));
+  return index < 0 ? NULL : entry_at(index);
+}
+
+// Definitions relinked to a word being forgotten keep its code, which they
+// hold a reference to, and are tracked as callers of the word it shadowed
+// in the same wordlist (if any) so that redefining that word relinks them
+// again
+static void retarget_links(int index, int from) {
+  dictionary_entry_t* entry = get_defined_entry(index);
+  const dictionary_entry_t* forgotten = entry_at(from);
+  const char* name = forgotten->name;
+  const size_t length = strlen(name);
+  const int to = find_below(forgotten->wordlist, from, name, length,
+                            name_hash(name, length));
 
-  cell_t def = {0};
-  def.type = CELL_NATIVE;
-  def.payload.native = func;
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < entry->link_count; i++) {
+    if (entry->links[i].entry == from) {
+      if (to < 0) continue;
+      entry->links[i].entry = to;
+      add_dependent(to, index);
+    }
+    entry->links[kept++] = entry->links[i];
+  }
+  entry->link_count = kept;
+}
 
-  dictionary[dict_size].definition = def;
-  dictionary[dict_size].help = help;
+// The newest wordlist, whose owner is being forgotten. Its own words were
+// defined after the owner, so they are already gone.
+static void drop_wordlist(void) {
+  const int id = atomic_load(&wordlist_count) - 1;
+  int order[MAX_SEARCH_ORDER];
+  int depth = 0;
+  const int old_depth = get_search_order(order);
+  for (int i = 0; i < old_depth; i++) {
+    if (order[i] != id) order[depth++] = order[i];
+  }
+  if (depth == 0) order[depth++] = FORTH_WORDLIST;
+  set_search_order(order, depth);
+  if (current_wordlist == id) current_wordlist = FORTH_WORDLIST;
 
-  debug("Added word '%s' to dictionary at index %d", name, dict_size);
-  dict_size++;
+  // Readers that picked up the id before it left the order may still
+  // search it
+  atomic_store(&wordlist_count, id);
+  epoch_retire(atomic_load(&wordlists[id]));
 }
 
-dictionary_entry_t* find_word(const char* name) {
-  for (int i = dict_size - 1; i >= 0; i--) {
-    if (stricmp(dictionary[i].name, name) == 0) {
-      debug("Found word '%s' at dictionary index %d", name, i);
-      return &dictionary[i];
+void forget_words(int size) {
+  if (size < builtin_count) size = builtin_count;  // Built-ins stay
+
+  while (get_dictionary_size() > size) {
+    const int index = get_dictionary_size() - 1;
+    dependents_t* callers = &dependents[index];
+    for (uint32_t i = 0; i < callers->count; i++) {
+      if (callers->entries[i] < index) {
+        retarget_links(callers->entries[i], index);
+      }
     }
+    set_word_links(index, NULL, 0);
+    metal_free(callers->entries);
+    memset(callers, 0, sizeof(dependents_t));
+
+    // Readers that already found the entry may still reach it, so its
+    // slot keeps its contents until the next definition synchronizes
+    dictionary_entry_t* entry = get_defined_entry(index);
+    wordlist_t* list = atomic_load(&wordlists[entry->wordlist]);
+    atomic_store_explicit(&list->heads[hashes[index] % WORDLIST_BUCKETS],
+                          chains[index], memory_order_release);
+    if (entry->flags & WORD_FLAG_VOCABULARY) drop_wordlist();
+    atomic_store_explicit(&defined_count, index - builtin_count,
+                          memory_order_release);
+    pop_name(entry->name);
+    epoch_retire_cell(entry->definition);
+    vacated = true;
   }
-  debug("Word '%s' not found in dictionary", name);
-  return NULL;
+}
+
+// Wordlists
+
+int create_wordlist(int owner) {
+  const int id = atomic_load(&wordlist_count);
+  if (id >= MAX_WORDLISTS) return -1;
+
+  wordlist_t* list = metal_alloc(sizeof(wordlist_t));
+  if (!list) return -1;
+  list->owner = owner;
+  for (int i = 0; i < WORDLIST_BUCKETS; i++) list->heads[i] = -1;
+  atomic_store(&wordlists[id], list);
+  atomic_store(&wordlist_count, id + 1);
+  return id;
+}
+
+int get_wordlist_count(void) { return atomic_load(&wordlist_count); }
+
+const char* get_wordlist_name(int wordlist) {
+  const int owner = atomic_load(&wordlists[wordlist])->owner;
+  return owner < 0 ? "FORTH" : entry_at(owner)->name;
+}
+
+int get_current_wordlist(void) { return current_wordlist; }
+
+void set_current_wordlist(int wordlist) { current_wordlist = wordlist; }
+
+int get_search_order(int* order) {
+  const int depth = atomic_load(&search_depth);
+  for (int i = 0; i < depth; i++) order[i] = atomic_load(&search_order[i]);
+  return depth;
+}
+
+void set_search_order(const int* order, int depth) {
+  for (int i = 0; i < depth; i++) atomic_store(&search_order[i], order[i]);
+  atomic_store(&search_depth, depth);
+}
+
+// Dependency tracking
+
+int get_entry_index(const dictionary_entry_t* entry) {
+  for (int i = 0; i < block_count; i++) {
+    if (entry >= blocks[i] && entry < blocks[i] + ENTRY_BLOCK_SIZE) {
+      return builtin_count + i * ENTRY_BLOCK_SIZE + (int)(entry - blocks[i]);
+    }
+  }
+  int index = 0;
+  for (int i = 0; i < builtin_table_count; i++) {
+    const word_table_t* table = builtin_tables[i];
+    if (entry >= table->entries && entry < table->entries + table->count) {
+      return index + (int)(entry - table->entries);
+    }
+    index += table->count;
+  }
+  return -1;
+}
+
+void set_word_links(int index, link_site_t* links, uint32_t count) {
+  dictionary_entry_t* entry = get_defined_entry(index);
+  for (uint32_t i = 0; i < entry->link_count; i++) {
+    remove_dependent(entry->links[i].entry, index);
+  }
+  metal_free(entry->links);
+
+  entry->links = links;
+  entry->link_count = count;
+  for (uint32_t i = 0; i < count; i++) {
+    add_dependent(links[i].entry, index);
+  }
+}
+
+void add_dependent(int index, int dependent) {
+  dependents_t* callers = &dependents[index];
+  for (uint32_t i = 0; i < callers->count; i++) {
+    if (callers->entries[i] == dependent) return;
+  }
+
+  if (callers->count == callers->capacity) {
+    const uint32_t capacity = callers->capacity ? callers->capacity * 2 : 4;
+    int* grown = metal_realloc(callers->entries, capacity * sizeof(int));
+    if (!grown) return;
+    callers->entries = grown;
+    callers->capacity = capacity;
+  }
+  callers->entries[callers->count++] = dependent;
+}
+
+void remove_dependent(int index, int dependent) {
+  dependents_t* callers = &dependents[index];
+  for (uint32_t i = 0; i < callers->count; i++) {
+    if (callers->entries[i] == dependent) {
+      callers->entries[i] = callers->entries[--callers->count];
+      return;
+    }
+  }
+}
+
+const int* get_dependents(int index, uint32_t* count) {
+  *count = dependents[index].count;
+  return dependents[index].entries;
 }
 
 // Dictionary introspection
 
-int get_dictionary_size(void) { return dict_size; }
+int get_dictionary_size(void) {
+  return builtin_count +
+         atomic_load_explicit(&defined_count, memory_order_acquire);
+}
+
+const dictionary_entry_t* get_dictionary_entry(int index) {
+  if (index < 0 || index >= get_dictionary_size()) {
+    return NULL;
+  }
+  return entry_at(index);
+}
 
-dictionary_entry_t* get_dictionary_entry(int index) {
-  if (index < 0 || index >= dict_size) {
+dictionary_entry_t* get_defined_entry(int index) {
+  if (index < builtin_count || index >= get_dictionary_size()) {
     return NULL;
   }
-  return &dictionary[index];
-}
\ No newline at end of file
+  return defined_at(index - builtin_count);
+}
+
+const char* find_word_name(const cell_t* definition) {
+  for (int i = get_dictionary_size() - 1; i >= 0; i--) {
+    const cell_t* candidate = &entry_at(i)->definition;
+    if (candidate->type != definition->type) continue;
+
+    if (candidate->type == CELL_NATIVE
+            ? candidate->payload.native == definition->payload.native
+            : candidate->payload.ptr == definition->payload.ptr) {
+      return entry_at(i)->name;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,254 @@
+#include "epoch.h"
+
+#include <stdatomic.h>
+
+#include "memory.h"
+#include "trace.h"
+
+#ifdef DEBUG_ENABLED
+#ifdef TARGET_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "array.h"
+#include "dictionary.h"
+#include "output.h"
+#endif
+
+#define MAX_EPOCH_READERS 8
+
+// Epochs start at 1; a reader slot holding 0 is quiescent
+static _Atomic uint32_t global_epoch = 1;
+static _Atomic uint32_t reader_epochs[MAX_EPOCH_READERS];
+static _Atomic bool registered[MAX_EPOCH_READERS];
+static int depths[MAX_EPOCH_READERS];  // Each owned by its reader
+
+// Retired by the updater, tagged with the epoch they were retired in
+typedef struct {
+  uint32_t epoch;
+  bool is_cell;
+  void* ptr;
+  cell_t cell;
+} retired_t;
+
+static retired_t* retired;
+static int retired_count;
+static int retired_capacity;
+
+// Readers
+
+int epoch_register(void) {
+  for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+    // Claimed in one step, so two registrations can't take the same slot
+    bool free = false;
+    if (atomic_compare_exchange_strong(&registered[i], &free, true)) {
+      depths[i] = 0;
+      atomic_store(&reader_epochs[i], 0);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void epoch_unregister(int slot) {
+  atomic_store(&reader_epochs[slot], 0);
+  atomic_store(&registered[slot], false);
+}
+
+void epoch_enter(int slot) {
+  if (depths[slot]++ > 0) return;
+
+  // Announce the epoch before reading anything it protects
+  atomic_store(&reader_epochs[slot], atomic_load(&global_epoch));
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epoch_exit(int slot) {
+  if (--depths[slot] > 0) return;
+  atomic_store_explicit(&reader_epochs[slot], 0, memory_order_release);
+}
+
+// Updater
+
+static void retire(retired_t item) {
+  if (retired_count == retired_capacity) {
+    const int capacity = retired_capacity ? retired_capacity * 2 : 16;
+    retired_t* grown = metal_realloc(retired, capacity * sizeof(retired_t));
+    if (!grown) return;
+    retired = grown;
+    retired_capacity = capacity;
+  }
+  item.epoch = atomic_load_explicit(&global_epoch, memory_order_relaxed);
+  retired[retired_count++] = item;
+}
+
+void epoch_retire(void* ptr) {
+  if (ptr) retire((retired_t){.ptr = ptr});
+}
+
+void epoch_retire_cell(cell_t cell) {
+  retire((retired_t){.is_cell = true, .cell = cell});
+}
+
+// Start a new epoch, returning the one that ended. Readers that announce
+// the new one can no longer see anything retired before it.
+static uint32_t advance(void) {
+  const uint32_t ended = atomic_load(&global_epoch);
+  atomic_store(&global_epoch, ended + 1);
+  atomic_thread_fence(memory_order_seq_cst);
+  return ended;
+}
+
+void epoch_reclaim(void) {
+  if (retired_count == 0) return;
+
+  uint32_t oldest = advance() + 1;
+  for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+    if (!atomic_load(&registered[i])) continue;
+    const uint32_t epoch = atomic_load(&reader_epochs[i]);
+    if (epoch && epoch < oldest) oldest = epoch;
+  }
+
+  int kept = 0;
+  for (int i = 0; i < retired_count; i++) {
+    retired_t* item = &retired[i];
+    if (item->epoch >= oldest) {
+      retired[kept++] = *item;
+    } else if (item->is_cell) {
+      metal_release(&item->cell);
+    } else {
+      metal_free(item->ptr);
+    }
+  }
+  trace(TRACE_RECLAIM, retired_count - kept, retired_count);
+  retired_count = kept;
+}
+
+void epoch_synchronize(void) {
+  const uint32_t ended = advance();
+  for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+    while (atomic_load(&registered[i])) {
+      const uint32_t epoch = atomic_load(&reader_epochs[i]);
+      if (epoch == 0 || epoch > ended) break;
+    }
+  }
+  epoch_reclaim();
+}
+
+#ifdef DEBUG_ENABLED
+// Self-check. The REPL never reads through a slot itself, so EPOCH-CHECK
+// does: it retires under a reader that is inside, and on Linux runs a
+// reader thread that looks a word up while the REPL redefines it. Build
+// with -fsanitize=thread or address to have every access checked too.
+
+#define PROBE_NAME "EPOCH-PROBE"
+#define PROBE_CAPACITY 8
+#define PROBE_ROUNDS 10000
+
+static bool is_retired(const void* ptr) {
+  for (int i = 0; i < retired_count; i++) {
+    if (!retired[i].is_cell && retired[i].ptr == ptr) return true;
+  }
+  return false;
+}
+
+// Something retired while a reader is inside outlives it, and no longer
+static const char* check_held(void) {
+  const int slot = epoch_register();
+  if (slot < 0) return "no free reader slot";
+  void* block = metal_alloc(sizeof(cell_t));
+  if (!block) {
+    epoch_unregister(slot);
+    return "out of memory";
+  }
+
+  epoch_enter(slot);
+  epoch_enter(slot);
+  epoch_retire(block);
+  epoch_exit(slot);  // Still inside the outer section
+  epoch_reclaim();
+  const bool held = is_retired(block);
+  epoch_exit(slot);
+  epoch_reclaim();
+  const bool released = !is_retired(block);
+  epoch_unregister(slot);
+
+  if (!held) return "reclaimed under a reader";
+  if (!released) return "not reclaimed after the reader left";
+  return NULL;
+}
+
+#ifdef TARGET_LINUX
+typedef struct {
+  int slot;
+  _Atomic bool stop;
+  uint32_t found;  // Lookups that found the probe
+  uint32_t torn;   // Of those, ones that saw it half made or freed
+} probe_reader_t;
+
+static void* read_probe(void* arg) {
+  probe_reader_t* reader = arg;
+  while (!atomic_load(&reader->stop)) {
+    epoch_enter(reader->slot);
+    const dictionary_entry_t* entry = find_word(PROBE_NAME);
+    sched_yield();  // So the updater forgets it while this reader is inside
+    if (entry) {
+      const array_data_t* data = entry->definition.payload.ptr;
+      reader->found++;
+      if (entry->definition.type != CELL_ARRAY ||
+          data->capacity != PROBE_CAPACITY) {
+        reader->torn++;
+      }
+    }
+    epoch_exit(reader->slot);
+  }
+  return NULL;
+}
+
+// Redefines and forgets the probe under a concurrent reader
+static const char* check_concurrent(void) {
+  probe_reader_t reader = {.slot = epoch_register()};
+  if (reader.slot < 0) return "no free reader slot";
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, read_probe, &reader) != 0) {
+    epoch_unregister(reader.slot);
+    return "cannot start a reader thread";
+  }
+
+  const int mark = get_dictionary_size();
+  for (int i = 0; i < PROBE_ROUNDS; i++) {
+    add_code_word(PROBE_NAME, new_array(PROBE_CAPACITY), NULL);
+    sched_yield();
+    forget_words(mark);
+    epoch_reclaim();
+  }
+  atomic_store(&reader.stop, true);
+  pthread_join(thread, NULL);
+  epoch_unregister(reader.slot);
+
+  if (reader.torn) return "a reader saw a torn or freed word";
+  output_format("EPOCH-CHECK : %u lookups found the probe\n", reader.found);
+  return NULL;
+}
+#else
+static const char* check_concurrent(void) { return NULL; }
+#endif
+
+// EPOCH-CHECK ( -- ) Check that readers keep what they can reach
+static void native_epoch_check([[maybe_unused]] context_t* ctx) {
+  trace_ring_t* tracing = trace_ring;
+  trace_ring = NULL;  // Only one context may write the ring
+
+  const char* failure = check_held();
+  if (!failure) failure = check_concurrent();
+  trace_ring = tracing;
+  if (failure) error("EPOCH-CHECK : %s", failure);
+}
+
+static const dictionary_entry_t epoch_entries[] = {
+    NATIVE_WORD("EPOCH-CHECK", native_epoch_check,
+                "( -- ) Check epoch reclamation against a reader"),
+};
+const word_table_t epoch_words = WORD_TABLE(epoch_entries);
+#endif
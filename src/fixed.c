@@ -0,0 +1,207 @@
+#include "fixed.h"
+
+#include <stdint.h>
+
+#include "array.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "metal.h"
+
+// Largest and smallest integers with a Q16.16 representation
+#define FIXED_INT_MAX (INT32_MAX >> FIXED_FRACTION_BITS)
+#define FIXED_INT_MIN (INT32_MIN >> FIXED_FRACTION_BITS)
+
+// Conversions
+
+int32_t fixed_saturate(int64_t raw) {
+  if (raw > INT32_MAX) return INT32_MAX;
+  if (raw < INT32_MIN) return INT32_MIN;
+  return (int32_t)raw;
+}
+
+int32_t fixed_from_int64(int64_t value) {
+  if (value > FIXED_INT_MAX) return INT32_MAX;
+  if (value < FIXED_INT_MIN) return INT32_MIN;
+  return (int32_t)(value * FIXED_ONE);
+}
+
+int32_t fixed_from_double(double value) {
+  if (value != value) return 0;  // NaN
+
+  const double scaled = value * FIXED_ONE;
+  if (scaled >= (double)INT32_MAX) return INT32_MAX;
+  if (scaled <= (double)INT32_MIN) return INT32_MIN;
+  return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+double fixed_to_double(int32_t raw) { return (double)raw / FIXED_ONE; }
+
+// Saturating arithmetic. Products and quotients are formed in 64 bits and
+// rounded to nearest before saturating.
+
+int32_t fixed_add(int32_t a, int32_t b) {
+  return fixed_saturate((int64_t)a + b);
+}
+
+int32_t fixed_subtract(int32_t a, int32_t b) {
+  return fixed_saturate((int64_t)a - b);
+}
+
+int32_t fixed_multiply(int32_t a, int32_t b) {
+  const int64_t product = (int64_t)a * b;
+  return fixed_saturate((product + (FIXED_ONE / 2)) >> FIXED_FRACTION_BITS);
+}
+
+int32_t fixed_divide(int32_t a, int32_t b) {
+  const int64_t numerator = (int64_t)a * FIXED_ONE;
+  const int64_t half = (b < 0 ? -(int64_t)b : b) / 2;
+  const int64_t rounded = (numerator < 0) == (b < 0) ? numerator + half
+                                                      : numerator - half;
+  return fixed_saturate(rounded / b);
+}
+
+// Kernels. Products are accumulated in Q32.32 and rounded once per output,
+// so a sum only saturates when the true result is out of range. The
+// accumulator holds sums of magnitude up to 2^31.
+
+void fixed_fir(const int32_t* input, size_t length, const int32_t* taps,
+               size_t tap_count, int32_t* output) {
+  for (size_t n = 0; n < length; n++) {
+    const size_t count = n + 1 < tap_count ? n + 1 : tap_count;
+    int64_t sum = 0;
+    for (size_t k = 0; k < count; k++) {
+      sum += (int64_t)taps[k] * input[n - k];
+    }
+    sum = (sum + (FIXED_ONE / 2)) >> FIXED_FRACTION_BITS;
+    output[n] = fixed_saturate(sum);
+  }
+}
+
+void fixed_moving_average(const int32_t* input, size_t length, size_t window,
+                          int32_t* output) {
+  // A running sum makes this linear in the length whatever the window
+  int64_t sum = 0;
+  for (size_t n = 0; n < length; n++) {
+    sum += input[n];
+    if (n >= window) sum -= input[n - window];
+    const int64_t count = n < window ? (int64_t)n + 1 : (int64_t)window;
+    output[n] = (int32_t)(sum / count);
+  }
+}
+
+// Words. Arrays of numbers are packed into Q16.16 buffers for the kernels
+// and the result is unpacked into a new array of fixed cells.
+
+static bool is_number_array(const cell_t* cell) {
+  if (cell->type == CELL_NIL) return true;
+  if (cell->type != CELL_ARRAY) return false;
+
+  const array_data_t* data = cell->payload.ptr;
+  for (size_t i = 0; i < data->length; i++) {
+    if (!is_number(&data->elements[i])) return false;
+  }
+  return true;
+}
+
+static int32_t* pack_array(const cell_t* cell, size_t* length) {
+  const array_data_t* data =
+      cell->type == CELL_ARRAY ? cell->payload.ptr : NULL;
+  *length = data ? data->length : 0;
+
+  int32_t* packed = metal_alloc((*length + 1) * sizeof(int32_t));
+  for (size_t i = 0; i < *length; i++) {
+    packed[i] = cell_to_fixed(&data->elements[i]);
+  }
+  return packed;
+}
+
+static cell_t unpack_array(const int32_t* packed, size_t length) {
+  if (length == 0) return new_nil();
+
+  cell_t array = new_array(length);
+  if (array.type != CELL_ARRAY) return array;
+
+  array_data_t* data = array.payload.ptr;
+  for (size_t i = 0; i < length; i++) {
+    data->elements[i] = new_fixed(packed[i]);
+  }
+  data->length = length;
+  return array;
+}
+
+// Replace the top two stack items with the result
+static void replace_two(context_t* ctx, cell_t result) {
+  cell_t* a = &ctx->data_stack[ctx->data_stack_ptr - 2];
+  metal_release(a);
+  metal_release(a + 1);
+  *a = result;
+  ctx->data_stack_ptr--;
+}
+
+// FIR ( samples taps -- filtered )
+static void native_fir(context_t* ctx) {
+  if (ctx->data_stack_ptr < 2) {
+    error("FIR: insufficient stack (need samples and taps)");
+    return;
+  }
+
+  const cell_t* samples = &ctx->data_stack[ctx->data_stack_ptr - 2];
+  if (!is_number_array(samples) || !is_number_array(samples + 1)) {
+    error("FIR: samples and taps must be arrays of numbers");
+    return;
+  }
+
+  size_t length, tap_count;
+  int32_t* input = pack_array(samples, &length);
+  int32_t* taps = pack_array(samples + 1, &tap_count);
+  int32_t* output = metal_alloc((length + 1) * sizeof(int32_t));
+
+  fixed_fir(input, length, taps, tap_count, output);
+  cell_t result = unpack_array(output, length);
+
+  metal_free(taps);
+  metal_free(input);
+  metal_free(output);
+  replace_two(ctx, result);
+}
+
+// MOVING-AVERAGE ( samples n -- averaged )
+static void native_moving_average(context_t* ctx) {
+  if (ctx->data_stack_ptr < 2) {
+    error("MOVING-AVERAGE: insufficient stack (need samples and window)");
+    return;
+  }
+
+  const cell_t* window = &ctx->data_stack[ctx->data_stack_ptr - 1];
+  if (window->type != CELL_INT32 || window->payload.i32 <= 0) {
+    error("MOVING-AVERAGE: window must be a positive integer");
+    return;
+  }
+
+  const cell_t* samples = &ctx->data_stack[ctx->data_stack_ptr - 2];
+  if (!is_number_array(samples)) {
+    error("MOVING-AVERAGE: samples must be an array of numbers");
+    return;
+  }
+
+  size_t length;
+  int32_t* input = pack_array(samples, &length);
+  int32_t* output = metal_alloc((length + 1) * sizeof(int32_t));
+
+  fixed_moving_average(input, length, (size_t)window->payload.i32, output);
+  cell_t result = unpack_array(output, length);
+
+  metal_free(input);
+  metal_free(output);
+  replace_two(ctx, result);
+}
+
+// Fixed-point signal processing words
+static const dictionary_entry_t fixed_entries[] = {
+    NATIVE_WORD("FIR", native_fir,
+                "( samples taps -- filtered ) Fixed-point FIR filter"),
+    NATIVE_WORD("MOVING-AVERAGE", native_moving_average,
+                "( samples n -- averaged ) Fixed-point moving average"),
+};
+const word_table_t fixed_words = WORD_TABLE(fixed_entries);
@@ -0,0 +1,477 @@
+#include "image.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cell.h"
+#include "code.h"
+#include "dictionary.h"
+#include "memory.h"
+#include "parser.h"
+#include "trace.h"
+#include "util.h"
+
+#define IMAGE_MAGIC 0x494D544D  // "MTMI"
+#define IMAGE_VERSION 2
+#define IMAGE_REFCOUNT (UINT32_MAX / 2)  // Never released to zero
+#define MAX_PATH_LENGTH 256
+
+// File layout: header, entries, link sites, heap objects (each after its
+// alloc_header_t, like metal_alloc memory), relocations
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t cell_size;
+  uint32_t entry_count;
+  uint64_t build;  // Fingerprint of the built-in words
+  uint64_t relocations;
+  uint64_t relocation_count;
+  uint64_t length;
+} image_header_t;
+
+typedef struct {
+  char name[32];
+  cell_t definition;
+  uint64_t help;   // File offset of the text
+  uint64_t hash;   // See INCLUDE
+  uint64_t links;  // File offset of the link sites
+  uint32_t link_count;
+  word_flags_t flags;
+  uint8_t wordlist;
+} image_entry_t;
+
+// A relocation is the file offset of a cell, shifted left, with the low bit
+// set when its payload is a native (relative to native_exit, since the
+// binary may load anywhere) and clear when it is a file offset
+#define RELOCATE_NATIVE 1
+
+static int builtin_count;
+static int builtin_wordlists;
+static uint64_t build_fingerprint;
+
+static int64_t native_offset(native_func_t native) {
+  return (int64_t)((intptr_t)native - (intptr_t)native_exit);
+}
+
+// Images only hold natives by offset, so they are tied to this binary
+void init_image(void) {
+  builtin_count = get_dictionary_size();
+  builtin_wordlists = get_wordlist_count();
+
+  uint64_t hash = fnv1a(METAL_VERSION, strlen(METAL_VERSION), FNV_OFFSET);
+  for (int i = 0; i < builtin_count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    hash = fnv1a(entry->name, strlen(entry->name), hash);
+    if (entry->definition.type == CELL_NATIVE) {
+      const int64_t offset = native_offset(entry->definition.payload.native);
+      hash = fnv1a(&offset, sizeof(offset), hash);
+    }
+  }
+  build_fingerprint = hash;
+}
+
+// Writing
+
+typedef enum { OBJECT_CODE, OBJECT_STRING, OBJECT_BIGINT } object_kind_t;
+
+typedef struct {
+  const void* ptr;
+  uint64_t offset;  // Of the payload in the file
+  object_kind_t kind;
+} image_object_t;
+
+typedef struct {
+  uint8_t* data;
+  size_t length;
+  size_t capacity;
+
+  // Objects in file order, and a hash table of their indices plus one
+  image_object_t* objects;
+  size_t object_count;
+  size_t object_capacity;
+  size_t objects_written;
+  uint32_t* slots;
+  size_t slot_count;  // Power of two
+
+  uint64_t* relocations;
+  size_t relocation_count;
+  size_t relocation_capacity;
+} image_writer_t;
+
+static void* grow(void* array, size_t* capacity, size_t needed,
+                  size_t item_size) {
+  if (needed <= *capacity) return array;
+  size_t grown = *capacity ? *capacity * 2 : 64;
+  while (grown < needed) grown *= 2;
+  array = metal_realloc(array, grown * item_size);
+  *capacity = grown;
+  return array;
+}
+
+// Zeroed space at the end of the file, returning its offset
+static uint64_t reserve(image_writer_t* w, size_t length) {
+  w->data = grow(w->data, &w->capacity, w->length + length, 1);
+  memset(w->data + w->length, 0, length);
+  const uint64_t offset = w->length;
+  w->length += length;
+  return offset;
+}
+
+static void align(image_writer_t* w, size_t alignment) {
+  reserve(w, (alignment - w->length % alignment) % alignment);
+}
+
+static void relocate(image_writer_t* w, uint64_t cell_offset, bool native) {
+  w->relocations = grow(w->relocations, &w->relocation_capacity,
+                        w->relocation_count + 1, sizeof(uint64_t));
+  w->relocations[w->relocation_count++] =
+      cell_offset << 1 | (native ? RELOCATE_NATIVE : 0);
+}
+
+static size_t object_size(const void* ptr, object_kind_t kind) {
+  switch (kind) {
+    case OBJECT_CODE:
+      return sizeof(code_data_t) +
+             ((const code_data_t*)ptr)->length * sizeof(cell_t);
+    case OBJECT_BIGINT:
+      return sizeof(bigint_data_t) +
+             ((const bigint_data_t*)ptr)->length * sizeof(uint32_t);
+    default:
+      return strlen(ptr) + 1;
+  }
+}
+
+static size_t slot_of(const image_writer_t* w, const void* ptr) {
+  const uint64_t key = (uint64_t)(uintptr_t)ptr;
+  return (size_t)fnv1a(&key, sizeof(key), FNV_OFFSET) & (w->slot_count - 1);
+}
+
+static void rehash(image_writer_t* w) {
+  metal_free(w->slots);
+  w->slot_count = w->slot_count ? w->slot_count * 2 : 256;
+  w->slots = metal_alloc(w->slot_count * sizeof(uint32_t));
+  memset(w->slots, 0, w->slot_count * sizeof(uint32_t));
+
+  for (size_t i = 0; i < w->object_count; i++) {
+    size_t slot = slot_of(w, w->objects[i].ptr);
+    while (w->slots[slot]) slot = (slot + 1) & (w->slot_count - 1);
+    w->slots[slot] = (uint32_t)(i + 1);
+  }
+}
+
+// File offset of an object, reserving space for it the first time it is
+// reached; its contents are written when the queue gets to it
+static uint64_t place_object(image_writer_t* w, const void* ptr,
+                             object_kind_t kind) {
+  if (w->object_count * 2 >= w->slot_count) rehash(w);
+
+  size_t slot = slot_of(w, ptr);
+  while (w->slots[slot]) {
+    const image_object_t* object = &w->objects[w->slots[slot] - 1];
+    if (object->ptr == ptr) return object->offset;
+    slot = (slot + 1) & (w->slot_count - 1);
+  }
+
+  // Payloads are aligned like the cells inside code
+  while ((w->length + sizeof(alloc_header_t)) % sizeof(uint64_t)) {
+    reserve(w, 1);
+  }
+  const uint64_t header = reserve(w, sizeof(alloc_header_t));
+  const alloc_header_t immortal = {.refcount = IMAGE_REFCOUNT};
+  memcpy(w->data + header, &immortal, sizeof(immortal));
+
+  w->objects = grow(w->objects, &w->object_capacity, w->object_count + 1,
+                    sizeof(image_object_t));
+  image_object_t* object = &w->objects[w->object_count++];
+  object->ptr = ptr;
+  object->kind = kind;
+  object->offset = reserve(w, object_size(ptr, kind));
+  w->slots[slot] = (uint32_t)w->object_count;
+  return object->offset;
+}
+
+// Store a cell at a file offset; false for values an image cannot hold
+static bool put_cell(image_writer_t* w, uint64_t at, const cell_t* cell) {
+  cell_t copy = *cell;
+  switch (cell->type) {
+    case CELL_CODE:
+    case CELL_STRING:
+    case CELL_BIGINT:
+      if (cell->payload.ptr) {
+        const object_kind_t kind = cell->type == CELL_CODE     ? OBJECT_CODE
+                                   : cell->type == CELL_BIGINT ? OBJECT_BIGINT
+                                                               : OBJECT_STRING;
+        copy.payload.i64 = (int64_t)place_object(w, cell->payload.ptr, kind);
+        relocate(w, at, false);
+      }
+      break;
+    case CELL_NATIVE:
+      copy.payload.i64 = native_offset(cell->payload.native);
+      relocate(w, at, true);
+      break;
+    case CELL_INTERNED:
+    case CELL_OBJECT:
+    case CELL_ARRAY:
+    case CELL_POINTER:
+      return false;
+    default:
+      break;
+  }
+  memcpy(w->data + at, &copy, sizeof(cell_t));
+  return true;
+}
+
+static bool put_object(image_writer_t* w, const image_object_t* object) {
+  if (object->kind != OBJECT_CODE) {
+    memcpy(w->data + object->offset, object->ptr,
+           object_size(object->ptr, object->kind));
+    return true;
+  }
+
+  // The register VM lowers the code again on first run
+  const code_data_t* code = object->ptr;
+  const code_data_t header = {.length = code->length, .ir = NULL};
+  memcpy(w->data + object->offset, &header, sizeof(header));
+
+  const uint64_t instructions =
+      object->offset + offsetof(code_data_t, instructions);
+  for (size_t i = 0; i < code->length; i++) {
+    if (!put_cell(w, instructions + i * sizeof(cell_t),
+                  &code->instructions[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Lay out the image in memory, returning the first word it cannot hold
+static const char* build_image(image_writer_t* w) {
+  const int end = get_dictionary_size();
+  const uint32_t count = (uint32_t)(end - builtin_count);
+
+  reserve(w, sizeof(image_header_t));
+  const uint64_t entries = reserve(w, count * sizeof(image_entry_t));
+
+  for (uint32_t i = 0; i < count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(builtin_count + i);
+    image_entry_t record = {.hash = entry->hash,
+                            .link_count = entry->link_count,
+                            .flags = entry->flags,
+                            .wordlist = entry->wordlist};
+    memcpy(record.name, entry->name, strlen(entry->name));
+
+    align(w, sizeof(uint64_t));
+    record.links = reserve(w, entry->link_count * sizeof(link_site_t));
+    if (entry->link_count) {
+      memcpy(w->data + record.links, entry->links,
+             entry->link_count * sizeof(link_site_t));
+    }
+    if (entry->help) {
+      record.help = place_object(w, entry->help, OBJECT_STRING);
+    }
+
+    const uint64_t at = entries + i * sizeof(image_entry_t);
+    memcpy(w->data + at, &record, sizeof(record));
+    if (!put_cell(w, at + offsetof(image_entry_t, definition),
+                  &entry->definition)) {
+      return entry->name;
+    }
+
+    // Objects reached from earlier ones are queued behind them
+    while (w->objects_written < w->object_count) {
+      const image_object_t object = w->objects[w->objects_written++];
+      if (!put_object(w, &object)) return entry->name;
+    }
+  }
+
+  align(w, sizeof(uint64_t));
+  const image_header_t header = {
+      .magic = IMAGE_MAGIC,
+      .version = IMAGE_VERSION,
+      .cell_size = sizeof(cell_t),
+      .entry_count = count,
+      .build = build_fingerprint,
+      .relocations = reserve(w, w->relocation_count * sizeof(uint64_t)),
+      .relocation_count = w->relocation_count,
+      .length = w->length,
+  };
+  memcpy(w->data + header.relocations, w->relocations,
+         w->relocation_count * sizeof(uint64_t));
+  memcpy(w->data, &header, sizeof(header));
+  return NULL;
+}
+
+// Loading. Images come from SAVE-IMAGE on this binary; the layout is
+// checked, the objects inside are trusted.
+
+static const char* relocate_image(uint8_t* base, size_t length) {
+  const image_header_t* header = (const image_header_t*)base;
+  if (length < sizeof(image_header_t) || header->magic != IMAGE_MAGIC ||
+      header->version != IMAGE_VERSION) {
+    return "not an image";
+  }
+  if (header->cell_size != sizeof(cell_t) ||
+      header->build != build_fingerprint) {
+    return "saved by a different build";
+  }
+  if (header->length != length || header->relocations % sizeof(uint64_t) ||
+      header->relocations > length ||
+      header->relocation_count >
+          (length - header->relocations) / sizeof(uint64_t) ||
+      header->entry_count >
+          (length - sizeof(image_header_t)) / sizeof(image_entry_t)) {
+    return "truncated";
+  }
+
+  const uint64_t* relocations = (const uint64_t*)(base + header->relocations);
+  for (uint64_t i = 0; i < header->relocation_count; i++) {
+    const uint64_t at = relocations[i] >> 1;
+    if (at % alignof(cell_t) || at > length - sizeof(cell_t)) {
+      return "bad relocation";
+    }
+
+    cell_t* cell = (cell_t*)(base + at);
+    if (relocations[i] & RELOCATE_NATIVE) {
+      cell->payload.native =
+          (native_func_t)((intptr_t)native_exit + cell->payload.i64);
+    } else if ((uint64_t)cell->payload.i64 < length) {
+      cell->payload.ptr = base + cell->payload.i64;
+    } else {
+      return "bad relocation";
+    }
+  }
+  return NULL;
+}
+
+static const char* check_entries(const uint8_t* base, size_t length) {
+  const image_header_t* header = (const image_header_t*)base;
+  const image_entry_t* entries =
+      (const image_entry_t*)(base + sizeof(image_header_t));
+  const int limit = builtin_count + (int)header->entry_count;
+
+  // Vocabulary words select their wordlist by number, counting from the
+  // built-in ones, so they only load before any others are defined
+  int wordlists = builtin_wordlists;
+  for (uint32_t i = 0; i < header->entry_count; i++) {
+    const image_entry_t* entry = &entries[i];
+    if (entry->flags & WORD_FLAG_VOCABULARY) {
+      if (get_wordlist_count() != builtin_wordlists) {
+        return "vocabularies already defined";
+      }
+      wordlists++;
+    }
+    if (entry->wordlist >= wordlists || wordlists > MAX_WORDLISTS) {
+      return "bad entry";
+    }
+    if (entry->name[sizeof(entry->name) - 1] != '\0' ||
+        entry->help >= length || entry->links > length ||
+        entry->link_count >
+            (length - entry->links) / sizeof(link_site_t)) {
+      return "bad entry";
+    }
+
+    const link_site_t* links = (const link_site_t*)(base + entry->links);
+    for (uint32_t l = 0; l < entry->link_count; l++) {
+      if (links[l].entry < 0 || links[l].entry >= limit) return "bad entry";
+    }
+  }
+  return NULL;
+}
+
+// Append the entries; words of the image are numbered from the end of the
+// built-ins when saved
+static void add_entries(const uint8_t* base) {
+  const image_header_t* header = (const image_header_t*)base;
+  const image_entry_t* entries =
+      (const image_entry_t*)(base + sizeof(image_header_t));
+  const int start = get_dictionary_size();
+  const int current = get_current_wordlist();
+
+  for (uint32_t i = 0; i < header->entry_count; i++) {
+    const image_entry_t* record = &entries[i];
+    set_current_wordlist(record->wordlist);
+    add_code_word(record->name, record->definition,
+                  record->help ? (const char*)base + record->help : NULL);
+    dictionary_entry_t* entry = get_defined_entry(start + (int)i);
+    entry->flags = record->flags;
+    entry->hash = record->hash;
+    if (entry->flags & WORD_FLAG_VOCABULARY) create_wordlist(start + (int)i);
+  }
+  set_current_wordlist(current);
+
+  for (uint32_t i = 0; i < header->entry_count; i++) {
+    const image_entry_t* record = &entries[i];
+    link_site_t* links =
+        metal_alloc(record->link_count * sizeof(link_site_t) + 1);
+    memcpy(links, base + record->links,
+           record->link_count * sizeof(link_site_t));
+    for (uint32_t l = 0; l < record->link_count; l++) {
+      if (links[l].entry >= builtin_count) {
+        links[l].entry += start - builtin_count;
+      }
+    }
+    set_word_links(start + (int)i, links, record->link_count);
+  }
+}
+
+const char* load_image(const char* path, image_file_t* image) {
+  if (!map_image_file(path, image)) return "cannot read file";
+
+  const char* failure = relocate_image(image->data, image->length);
+  if (!failure) failure = check_entries(image->data, image->length);
+  if (failure) {
+    unmap_image_file(image);
+    return failure;
+  }
+
+  add_entries(image->data);
+  trace(TRACE_IMAGE_LOAD, image->length);
+  return NULL;
+}
+
+// SAVE-IMAGE ( -- ) Write the words defined so far to the file named next
+static void native_save_image(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) == TOKEN_EOF) {
+    error("SAVE-IMAGE : missing file name");
+    return;
+  }
+  if (name.length >= MAX_PATH_LENGTH) {
+    error("SAVE-IMAGE : file name too long");
+    return;
+  }
+
+  char path[MAX_PATH_LENGTH];
+  memcpy(path, name.start, name.length);
+  path[name.length] = '\0';
+
+  image_writer_t w = {0};
+  const char* failure = build_image(&w);
+
+  bool written = false;
+  FILE* file = failure ? NULL : fopen(path, "wb");
+  if (file) {
+    written = fwrite(w.data, 1, w.length, file) == w.length;
+    if (fclose(file) != 0) written = false;
+    if (!written) remove(path);
+  }
+
+  metal_free(w.data);
+  metal_free(w.objects);
+  metal_free(w.slots);
+  metal_free(w.relocations);
+
+  if (failure) {
+    error("SAVE-IMAGE : %s holds a value an image cannot store", failure);
+  } else if (!written) {
+    error("SAVE-IMAGE : cannot write %s", path);
+  }
+}
+
+// Image words
+static const dictionary_entry_t image_entries[] = {
+    NATIVE_WORD("SAVE-IMAGE", native_save_image,
+                "( -- ) Save the words defined so far to a file"),
+};
+const word_table_t image_words = WORD_TABLE(image_entries);
@@ -0,0 +1,591 @@
+#include "ir.h"
+
+#include <string.h>
+
+#include "bigint.h"
+#include "code.h"
+#include "core.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "output.h"
+#include "parser.h"
+#include "profile.h"
+#include "stack.h"
+#include "trace.h"
+#include "util.h"
+
+#define MAX_IR_REGISTERS 255
+#define MAX_SYMBOLIC_DEPTH 64
+
+// Engine selection
+bool register_engine_enabled = false;
+
+// Natives that lower to IR_BINARY
+typedef struct {
+  native_func_t native;
+  binary_func_t binary;
+  const char* name;
+} binary_lowering_t;
+
+static const binary_lowering_t binary_lowerings[] = {
+    {native_add, add_cells, "+"},
+    {native_subtract, subtract_cells, "-"},
+    {native_multiply, multiply_cells, "*"},
+    {native_divide, divide_cells, "/"},
+    {native_mod, mod_cells, "MOD"},
+    {native_less, less_cells, "<"},
+    {native_greater, greater_cells, ">"},
+    {native_equal, equal_cells, "="},
+    {native_not_equal, not_equal_cells, "<>"},
+    {native_less_equal, less_equal_cells, "<="},
+    {native_greater_equal, greater_equal_cells, ">="},
+};
+
+static const binary_lowering_t* find_binary_lowering(native_func_t native) {
+  for (size_t i = 0;
+       i < sizeof(binary_lowerings) / sizeof(binary_lowerings[0]); i++) {
+    if (binary_lowerings[i].native == native) return &binary_lowerings[i];
+  }
+  return NULL;
+}
+
+// Lowering state. Within a basic block the data stack is tracked
+// symbolically as a stack of registers; it is written back (flushed) before
+// anything that needs the real stack and at every block boundary.
+typedef struct {
+  ir_instruction_t* out;
+  size_t length;
+  size_t capacity;
+
+  uint8_t stack[MAX_SYMBOLIC_DEPTH];  // Registers, top of stack last
+  int depth;
+
+  int next_register;  // Registers are allocated afresh in each block
+  int register_count;
+  bool managed[MAX_IR_REGISTERS];   // May hold a refcounted value
+  bool consumed[MAX_IR_REGISTERS];  // Released by a later instruction
+} lowering_t;
+
+static ir_instruction_t* emit(lowering_t* l, ir_opcode_t op) {
+  if (l->length >= l->capacity) {
+    size_t new_capacity = l->capacity ? l->capacity * 2 : 16;
+    ir_instruction_t* grown =
+        metal_realloc(l->out, new_capacity * sizeof(ir_instruction_t));
+    if (!grown) {
+      error("Out of memory");  // Callers use the instruction unchecked
+      return NULL;
+    }
+    l->out = grown;
+    l->capacity = new_capacity;
+  }
+
+  ir_instruction_t* instruction = &l->out[l->length++];
+  memset(instruction, 0, sizeof(*instruction));
+  instruction->op = op;
+  return instruction;
+}
+
+static uint8_t new_register(lowering_t* l, bool managed) {
+  uint8_t reg = (uint8_t)l->next_register++;
+  l->managed[reg] = managed;
+  l->consumed[reg] = false;
+  if (l->next_register > l->register_count) {
+    l->register_count = l->next_register;
+  }
+  return reg;
+}
+
+static bool is_managed_type(cell_type_t type) {
+  switch (type) {
+    case CELL_STRING:
+    case CELL_BIGINT:
+    case CELL_OBJECT:
+    case CELL_ARRAY:
+    case CELL_CODE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Make sure the top n stack items are in registers, popping the rest
+static void ensure(lowering_t* l, int n) {
+  while (l->depth < n) {
+    uint8_t reg = new_register(l, true);
+    emit(l, IR_POP)->dst = reg;
+
+    // The popped value sits below everything tracked so far
+    memmove(&l->stack[1], &l->stack[0], l->depth * sizeof(l->stack[0]));
+    l->stack[0] = reg;
+    l->depth++;
+  }
+}
+
+static bool used_above(const lowering_t* l, int index, uint8_t reg) {
+  for (int i = index + 1; i < l->depth; i++) {
+    if (l->stack[i] == reg) return true;
+  }
+  return false;
+}
+
+// Write the symbolic stack back to the data stack and end the block
+static void flush(lowering_t* l) {
+  bool moved[MAX_IR_REGISTERS] = {0};
+
+  for (int i = 0; i < l->depth; i++) {
+    uint8_t reg = l->stack[i];
+    bool last_use = !used_above(l, i, reg) && !l->consumed[reg];
+
+    if (last_use || !l->managed[reg]) {
+      emit(l, IR_PUSH_MOVE)->src1 = reg;
+      moved[reg] = true;
+    } else {
+      emit(l, IR_PUSH)->src1 = reg;
+    }
+  }
+
+  for (int reg = 0; reg < l->next_register; reg++) {
+    if (l->managed[reg] && !moved[reg] && !l->consumed[reg]) {
+      emit(l, IR_RELEASE)->src1 = (uint8_t)reg;
+    }
+  }
+
+  l->depth = 0;
+  l->next_register = 0;
+}
+
+static bool is_branch(const cell_t* instruction) {
+  return instruction->type == CELL_NATIVE &&
+         (instruction->payload.native == native_branch ||
+          instruction->payload.native == native_zbranch);
+}
+
+static void lower_native(lowering_t* l, const code_data_t* code, size_t* i) {
+  // Quickened variants lower like the generic word they stand for
+  const cell_t* instruction = &code->instructions[*i];
+  native_func_t native = generic_variant(instruction->payload.native);
+  const binary_lowering_t* lowering;
+
+  if (native == native_dup) {
+    ensure(l, 1);
+    l->stack[l->depth] = l->stack[l->depth - 1];
+    l->depth++;
+  } else if (native == native_drop) {
+    ensure(l, 1);
+    l->depth--;
+  } else if (native == native_swap) {
+    ensure(l, 2);
+    uint8_t top = l->stack[l->depth - 1];
+    l->stack[l->depth - 1] = l->stack[l->depth - 2];
+    l->stack[l->depth - 2] = top;
+  } else if ((lowering = find_binary_lowering(native))) {
+    ensure(l, 2);
+    ir_instruction_t* binary = emit(l, IR_BINARY);
+    binary->src2 = l->stack[--l->depth];
+    binary->src1 = l->stack[--l->depth];
+    binary->binary = lowering->binary;
+    binary->dst = new_register(l, true);
+    l->stack[l->depth++] = binary->dst;
+  } else if (native == native_exit) {
+    flush(l);
+    emit(l, IR_RETURN);
+  } else if (native == native_branch) {
+    flush(l);
+    (*i)++;
+    ir_instruction_t* jump = emit(l, IR_JUMP);
+    jump->target = (int32_t)*i + code->instructions[*i].payload.i32;
+  } else if (native == native_zbranch) {
+    ensure(l, 1);
+    uint8_t condition = l->stack[--l->depth];
+    l->consumed[condition] = true;
+    flush(l);
+    (*i)++;
+    ir_instruction_t* jump = emit(l, IR_JUMP_IF_FALSE);
+    jump->src1 = condition;
+    jump->target = (int32_t)*i + code->instructions[*i].payload.i32;
+  } else {
+    flush(l);
+    emit(l, IR_CALL_NATIVE)->native = native;
+  }
+}
+
+ir_code_t* ir_lower(const code_data_t* code) {
+  lowering_t l = {0};
+
+  // Map threaded code indices to IR indices for jump targets
+  size_t* ir_index = metal_alloc(code->length * sizeof(size_t));
+  bool* is_target = metal_alloc(code->length * sizeof(bool));
+  if (!ir_index || !is_target) {
+    metal_free(ir_index);
+    metal_free(is_target);
+    return NULL;
+  }
+
+  memset(is_target, 0, code->length * sizeof(bool));
+  for (size_t i = 0; i + 1 < code->length; i++) {
+    if (is_branch(&code->instructions[i])) {
+      is_target[i + 1 + code->instructions[i + 1].payload.i32] = true;
+      i++;
+    }
+  }
+
+  for (size_t i = 0; i < code->length; i++) {
+    // Keep room for the registers a single instruction may allocate
+    if (is_target[i] || l.depth > MAX_SYMBOLIC_DEPTH - 2 ||
+        l.next_register > MAX_IR_REGISTERS - 3) {
+      flush(&l);
+    }
+
+    ir_index[i] = l.length;
+    const cell_t* instruction = &code->instructions[i];
+
+    switch (instruction->type) {
+      case CELL_NATIVE:
+        lower_native(&l, code, &i);
+        break;
+      case CELL_CODE:
+        flush(&l);
+        emit(&l, instruction->flags & CELL_FLAG_TAIL_CALL ? IR_TAIL_CALL
+                                                          : IR_CALL)
+            ->code = instruction->payload.ptr;
+        break;
+      default: {
+        ir_instruction_t* load = emit(&l, IR_LOAD);
+        load->constant = *instruction;
+        load->dst = new_register(&l, is_managed_type(instruction->type));
+        l.stack[l.depth++] = load->dst;
+        break;
+      }
+    }
+  }
+
+  // Resolve jump targets
+  for (size_t i = 0; i < l.length; i++) {
+    if (l.out[i].op == IR_JUMP || l.out[i].op == IR_JUMP_IF_FALSE) {
+      l.out[i].target = (int32_t)ir_index[l.out[i].target];
+    }
+  }
+
+  ir_code_t* ir =
+      metal_alloc(sizeof(ir_code_t) + l.length * sizeof(ir_instruction_t));
+  if (ir) {
+    ir->length = l.length;
+    ir->register_count = (uint16_t)l.register_count;
+    memcpy(ir->instructions, l.out, l.length * sizeof(ir_instruction_t));
+    trace(TRACE_LOWER, code->length, l.length, l.register_count);
+  }
+
+  metal_free(l.out);
+  metal_free(ir_index);
+  metal_free(is_target);
+  return ir;
+}
+
+// Register VM
+
+// Run one frame; returns the target of a tail call, or NULL on return
+static code_data_t* ir_run(context_t* ctx, code_data_t* code) {
+  if (!code->ir) {
+    code->ir = ir_lower(code);
+    if (!code->ir) return NULL;
+  }
+
+  const ir_code_t* ir = code->ir;
+  cell_t registers[ir->register_count ? ir->register_count : 1];
+
+  const ir_instruction_t* pc = ir->instructions;
+  for (;;) {
+    switch (pc->op) {
+      case IR_LOAD:
+        registers[pc->dst] = pc->constant;
+        metal_retain(&registers[pc->dst]);
+        break;
+      case IR_POP:
+        registers[pc->dst] = data_pop(ctx);
+        break;
+      case IR_PUSH:
+        data_push(ctx, registers[pc->src1]);
+        break;
+      case IR_PUSH_MOVE:
+        if (ctx->data_stack_ptr >= DATA_STACK_SIZE) {
+          error("Data stack overflow");
+        }
+        ctx->data_stack[ctx->data_stack_ptr++] = registers[pc->src1];
+        break;
+      case IR_RELEASE:
+        metal_release(&registers[pc->src1]);
+        break;
+      case IR_BINARY:
+        registers[pc->dst] =
+            pc->binary(&registers[pc->src1], &registers[pc->src2]);
+        break;
+      case IR_CALL_NATIVE:
+        if (profile_enabled) {
+          profile_enter_native(pc->native);
+          pc->native(ctx);
+          profile_exit();
+        } else {
+          pc->native(ctx);
+        }
+        break;
+      case IR_CALL:
+        ir_execute(ctx, pc->code);
+        break;
+      case IR_TAIL_CALL:
+        // Registers are dead after a flush, so the frame can go
+        return pc->code;
+      case IR_JUMP:
+        pc = &ir->instructions[pc->target];
+        continue;
+      case IR_JUMP_IF_FALSE: {
+        bool flag = is_true(&registers[pc->src1]);
+        metal_release(&registers[pc->src1]);
+        if (!flag) {
+          pc = &ir->instructions[pc->target];
+          continue;
+        }
+        break;
+      }
+      case IR_RETURN:
+        return NULL;
+    }
+    pc++;
+  }
+}
+
+void ir_execute(context_t* ctx, code_data_t* code) {
+  // A frame marker keeps return stack depth in step with the stack engine.
+  // It points at the start of the running code, where no return address
+  // can, so the sampling profiler can tell the two apart.
+  return_push(ctx, new_pointer(code->instructions));
+  cell_t* marker = &ctx->return_stack[ctx->return_stack_ptr - 1];
+
+  // Read once, so a word that switches profiling still returns the way it
+  // was called
+  const bool profiling = profile_enabled;
+  while (code) {
+    marker->payload.pointer = code->instructions;
+    if (profiling) profile_enter_code(code);
+    code = ir_run(ctx, code);
+    if (profiling) profile_exit();
+  }
+
+  return_pop(ctx);
+}
+
+// Engine comparison
+
+static bool same_cell(const cell_t* a, const cell_t* b) {
+  if (a->type != b->type) return false;
+
+  switch (a->type) {
+    case CELL_INT32:
+    case CELL_FLOAT32:
+    case CELL_FIXED:
+      return a->payload.i32 == b->payload.i32;  // Bitwise for floats
+    case CELL_INT64:
+    case CELL_FLOAT:
+      return a->payload.i64 == b->payload.i64;  // Bitwise for floats
+    case CELL_STRING:
+      return strcmp(a->payload.ptr, b->payload.ptr) == 0;
+    case CELL_BIGINT:
+      return bigint_compare(a, b) == 0;
+    case CELL_ARRAY: {
+      const array_data_t* x = a->payload.ptr;
+      const array_data_t* y = b->payload.ptr;
+      if (x->length != y->length) return false;
+      for (size_t i = 0; i < x->length; i++) {
+        if (!same_cell(&x->elements[i], &y->elements[i])) return false;
+      }
+      return true;
+    }
+    case CELL_NIL:
+    case CELL_EMPTY:
+    case CELL_NULL:
+    case CELL_UNDEFINED:
+      return true;
+    default:
+      return a->payload.ptr == b->payload.ptr;
+  }
+}
+
+static void clear_data_stack(context_t* ctx) {
+  while (!is_data_empty(ctx)) {
+    cell_t cell = data_pop(ctx);
+    metal_release(&cell);
+  }
+}
+
+static cell_t* copy_data_stack(context_t* ctx, int* depth) {
+  *depth = data_depth(ctx);
+  cell_t* copy = metal_alloc((*depth + 1) * sizeof(cell_t));
+  for (int i = 0; i < *depth; i++) {
+    copy[i] = ctx->data_stack[i];
+    metal_retain(&copy[i]);
+  }
+  return copy;
+}
+
+static void release_copy(cell_t* copy, int depth) {
+  for (int i = 0; i < depth; i++) {
+    metal_release(&copy[i]);
+  }
+  metal_free(copy);
+}
+
+static code_data_t* parse_code_word(context_t* ctx, const char* word) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) != TOKEN_WORD) {
+    error("%s : missing word name", word);
+  }
+
+  const dictionary_entry_t* entry = find_word_span(name.start, name.length);
+  if (!entry) {
+    error("%s : unknown word %.*s", word, (int)name.length, name.start);
+  }
+  if (entry->definition.type != CELL_CODE) {
+    error("%s : %.*s is not a compiled word", word, (int)name.length,
+          name.start);
+  }
+
+  return entry->definition.payload.ptr;
+}
+
+static void native_register_vm([[maybe_unused]] context_t* ctx) {
+  register_engine_enabled = true;
+  output_text("Compiled words run on the register VM\n");
+}
+
+static void native_stack_vm([[maybe_unused]] context_t* ctx) {
+  register_engine_enabled = false;
+  output_text("Compiled words run on the stack engine\n");
+}
+
+static void native_ir_check(context_t* ctx) {
+  code_data_t* code = parse_code_word(ctx, "IR-CHECK");
+
+  int input_depth;
+  cell_t* input = copy_data_stack(ctx, &input_depth);
+
+  // Stack engine first, then the same input on the register VM
+  execute_threaded(ctx, code);
+  int expected_depth;
+  cell_t* expected = copy_data_stack(ctx, &expected_depth);
+
+  clear_data_stack(ctx);
+  for (int i = 0; i < input_depth; i++) {
+    data_push(ctx, input[i]);
+  }
+  ir_execute(ctx, code);
+
+  bool identical = expected_depth == data_depth(ctx);
+  for (int i = 0; identical && i < expected_depth; i++) {
+    identical = same_cell(&expected[i], &ctx->data_stack[i]);
+  }
+
+  if (identical) {
+    output_format("IR-CHECK: identical (%d cells)\n", expected_depth);
+  } else {
+    output_text("IR-CHECK: MISMATCH\nStack engine: ");
+    for (int i = 0; i < expected_depth; i++) {
+      if (i > 0) output_char(' ');
+      print_cell(&expected[i]);
+    }
+    output_text("\nRegister VM:  ");
+    for (int i = 0; i < data_depth(ctx); i++) {
+      if (i > 0) output_char(' ');
+      print_cell(&ctx->data_stack[i]);
+    }
+    output_char('\n');
+  }
+
+  release_copy(input, input_depth);
+  release_copy(expected, expected_depth);
+}
+
+static const char* binary_name(binary_func_t binary) {
+  for (size_t i = 0;
+       i < sizeof(binary_lowerings) / sizeof(binary_lowerings[0]); i++) {
+    if (binary_lowerings[i].binary == binary) return binary_lowerings[i].name;
+  }
+  return "?";
+}
+
+static void native_see_ir(context_t* ctx) {
+  code_data_t* code = parse_code_word(ctx, "SEE-IR");
+  if (!code->ir) {
+    code->ir = ir_lower(code);
+    if (!code->ir) return;
+  }
+
+  const ir_code_t* ir = code->ir;
+  output_format("%zu instructions, %d registers\n", ir->length,
+                ir->register_count);
+
+  for (size_t i = 0; i < ir->length; i++) {
+    const ir_instruction_t* in = &ir->instructions[i];
+    output_format("%4zu  ", i);
+    switch (in->op) {
+      case IR_LOAD:
+        output_format("r%d = ", in->dst);
+        print_cell(&in->constant);
+        break;
+      case IR_POP:
+        output_format("r%d = pop", in->dst);
+        break;
+      case IR_PUSH:
+        output_format("push r%d", in->src1);
+        break;
+      case IR_PUSH_MOVE:
+        output_format("push r%d (move)", in->src1);
+        break;
+      case IR_RELEASE:
+        output_format("release r%d", in->src1);
+        break;
+      case IR_BINARY:
+        output_format("r%d = r%d %s r%d", in->dst, in->src1,
+                      binary_name(in->binary), in->src2);
+        break;
+      case IR_CALL_NATIVE: {
+        cell_t native = {.type = CELL_NATIVE, .payload.native = in->native};
+        const char* name = find_word_name(&native);
+        output_format("call %s", name ? name : "<native>");
+        break;
+      }
+      case IR_CALL:
+      case IR_TAIL_CALL: {
+        cell_t callee = new_code(in->code);
+        const char* name = find_word_name(&callee);
+        output_format("%s %s", in->op == IR_CALL ? "call" : "tail call",
+                      name ? name : "<code>");
+        break;
+      }
+      case IR_JUMP:
+        output_format("jump %d", in->target);
+        break;
+      case IR_JUMP_IF_FALSE:
+        output_format("jump %d if r%d is false", in->target, in->src1);
+        break;
+      case IR_RETURN:
+        output_text("return");
+        break;
+    }
+    output_char('\n');
+  }
+}
+
+// IR words
+static const dictionary_entry_t ir_entries[] = {
+    NATIVE_WORD("REGISTER-VM", native_register_vm,
+                "( -- ) Run compiled words on the register VM"),
+    NATIVE_WORD("STACK-VM", native_stack_vm,
+                "( -- ) Run compiled words on the stack engine"),
+    NATIVE_WORD("IR-CHECK", native_ir_check,
+                "( i*x \"name\" -- j*x ) Run a word on both engines and "
+                "compare the results"),
+    NATIVE_WORD("SEE-IR", native_see_ir,
+                "( \"name\" -- ) Show the register IR of a word"),
+};
+const word_table_t ir_words = WORD_TABLE(ir_entries);
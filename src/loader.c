@@ -0,0 +1,803 @@
+#include "loader.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bigint.h"
+#include "cell.h"
+#include "code.h"
+#include "compiler.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "parser.h"
+#include "source_file.h"
+#include "timer.h"
+#include "trace.h"
+#include "util.h"
+
+#define CACHE_MAGIC 0x434C544D  // "MTLC"
+#define CACHE_VERSION 3
+#define CACHE_SUFFIX ".cache"
+#define MAX_INCLUDE_DEPTH 16
+#define MAX_NESTED_INCLUDES 32
+#define MAX_IMPORTS 256
+#define MAX_PATH_LENGTH 256
+
+typedef enum : uint8_t { RECORD_DEFINE, RECORD_INCLUDE } record_kind_t;
+
+// How a cached cell names the native or code it calls
+typedef enum : uint8_t {
+  REF_EXIT,
+  REF_BRANCH,
+  REF_ZBRANCH,
+  REF_SELF,    // RECURSE
+  REF_LOCAL,   // Entry added while loading the file, relative to the first
+  REF_IMPORT,  // Entry from before the file, by import table index
+} ref_kind_t;
+
+typedef struct {
+  char* path;
+  int start, end;  // Dictionary entries it added
+  uint64_t key;
+} nested_include_t;
+
+// A file being loaded
+typedef struct include_frame {
+  struct include_frame* parent;
+  int start;       // First dictionary entry added by the file
+  bool cacheable;  // False once a nested file could not be cached
+  int include_count;
+  nested_include_t includes[MAX_NESTED_INCLUDES];
+} include_frame_t;
+
+static include_frame_t* current_frame;
+static int include_depth;
+static char include_error[MAX_PATH_LENGTH + 64];
+
+static bool include_file(context_t* ctx, const char* path, uint64_t* key);
+
+// Keys
+
+static uint64_t hash_u64(uint64_t value, uint64_t hash) {
+  return fnv1a(&value, sizeof(value), hash);
+}
+
+// A key no cache written by another session can match
+static uint64_t session_key(void) {
+  static uint64_t seed, counter;
+  if (!seed) seed = hash_u64(timer_ns(), FNV_OFFSET);
+  return hash_u64(++counter, seed);
+}
+
+static uint64_t entry_hash(const dictionary_entry_t* entry) {
+  // A native is the same word in every session; a definition made outside
+  // INCLUDE is only known to this one
+  if (entry->definition.type == CELL_NATIVE) {
+    return fnv1a(entry->name, strlen(entry->name), FNV_OFFSET);
+  }
+  dictionary_entry_t* defined = get_defined_entry(get_entry_index(entry));
+  if (!defined->hash) defined->hash = session_key();
+  return defined->hash;
+}
+
+// Entries the file added itself are identified by its key and position;
+// those from nested files already have their own
+static void assign_hashes(const include_frame_t* frame, uint64_t key) {
+  const int end = get_dictionary_size();
+  int nested = 0;
+  for (int i = frame->start; i < end; i++) {
+    if (nested < frame->include_count &&
+        i == frame->includes[nested].start) {
+      i = frame->includes[nested++].end - 1;
+      continue;
+    }
+    get_defined_entry(i)->hash = hash_u64(i - frame->start, key);
+  }
+}
+
+// Newest entry whose definition is the native or code a compiled cell calls
+static int find_entry(const cell_t* cell) {
+  const native_func_t native = cell->type == CELL_NATIVE
+                                   ? generic_variant(cell->payload.native)
+                                   : NULL;
+  for (int i = get_dictionary_size() - 1; i >= 0; i--) {
+    const cell_t* definition = &get_dictionary_entry(i)->definition;
+    if (definition->type != cell->type) continue;
+    if (native ? definition->payload.native == native
+               : definition->payload.ptr == cell->payload.ptr) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Writing
+
+typedef struct {
+  uint8_t* data;
+  size_t length;
+  size_t capacity;
+  bool failed;  // Ran out of memory; nothing more is written
+} writer_t;
+
+static void put(writer_t* w, const void* bytes, size_t length) {
+  if (w->failed) return;
+  if (w->length + length > w->capacity) {
+    size_t capacity = w->capacity ? w->capacity * 2 : 256;
+    while (capacity < w->length + length) capacity *= 2;
+    uint8_t* grown = metal_realloc(w->data, capacity);
+    if (!grown) {
+      w->failed = true;
+      return;
+    }
+    w->data = grown;
+    w->capacity = capacity;
+  }
+  memcpy(w->data + w->length, bytes, length);
+  w->length += length;
+}
+
+static void put_u8(writer_t* w, uint8_t value) { put(w, &value, 1); }
+static void put_u32(writer_t* w, uint32_t value) { put(w, &value, 4); }
+static void put_u64(writer_t* w, uint64_t value) { put(w, &value, 8); }
+
+static void put_text(writer_t* w, const char* text) {
+  const size_t length = text ? strlen(text) : 0;
+  put_u32(w, (uint32_t)length);
+  put(w, text, length);
+}
+
+// Entries from before the file are imported by name; the import table is
+// only used while saving, which never nests
+static int import_entries[MAX_IMPORTS];
+static int import_count;
+
+static bool put_ref(writer_t* w, const include_frame_t* frame, int index) {
+  if (index < 0) return false;
+  if (index >= frame->start) {
+    put_u8(w, REF_LOCAL);
+    put_u32(w, (uint32_t)(index - frame->start));
+    return true;
+  }
+
+  int slot = 0;
+  while (slot < import_count && import_entries[slot] != index) slot++;
+  if (slot == import_count) {
+    if (import_count >= MAX_IMPORTS) return false;
+    import_entries[import_count++] = index;
+  }
+  put_u8(w, REF_IMPORT);
+  put_u32(w, (uint32_t)slot);
+  return true;
+}
+
+static bool put_cell(writer_t* w, const include_frame_t* frame,
+                     const code_data_t* code, const cell_t* cell) {
+  put_u8(w, cell->type);
+  put_u8(w, cell->flags);
+
+  switch (cell->type) {
+    case CELL_INT32:
+    case CELL_INT64:
+    case CELL_FLOAT:
+    case CELL_FLOAT32:
+    case CELL_FIXED:
+      put(w, &cell->payload, sizeof(cell->payload));
+      return true;
+    case CELL_STRING:
+      put_text(w, cell->payload.ptr);
+      return true;
+    case CELL_BIGINT: {
+      char* digits = bigint_to_string(cell->payload.ptr);
+      put_text(w, digits);
+      metal_free(digits);
+      return true;
+    }
+    case CELL_NATIVE:
+      if (cell->payload.native == native_exit) {
+        put_u8(w, REF_EXIT);
+      } else if (cell->payload.native == native_branch) {
+        put_u8(w, REF_BRANCH);
+      } else if (cell->payload.native == native_zbranch) {
+        put_u8(w, REF_ZBRANCH);
+      } else {
+        return put_ref(w, frame, find_entry(cell));
+      }
+      return true;
+    case CELL_CODE:
+      if (cell->payload.ptr == code) {
+        put_u8(w, REF_SELF);
+        return true;
+      }
+      return put_ref(w, frame, find_entry(cell));
+    default:
+      return false;  // No cached form
+  }
+}
+
+static bool put_define(writer_t* w, const include_frame_t* frame,
+                       const dictionary_entry_t* entry) {
+  if (entry->definition.type != CELL_CODE || entry->flags) return false;
+
+  const code_data_t* code = entry->definition.payload.ptr;
+  put_u8(w, RECORD_DEFINE);
+  put_text(w, entry->name);
+  put_text(w, entry->help);
+  put_u32(w, (uint32_t)code->length);
+  for (size_t i = 0; i < code->length; i++) {
+    if (!put_cell(w, frame, code, &code->instructions[i])) return false;
+  }
+
+  // Link sites, so a later redefinition can relink the replayed code. An
+  // inlined word becomes an import even though no cell names it.
+  put_u32(w, entry->link_count);
+  for (uint32_t i = 0; i < entry->link_count; i++) {
+    put_u32(w, entry->links[i].position);
+    put_u32(w, entry->links[i].length);
+    if (!put_ref(w, frame, entry->links[i].entry)) return false;
+  }
+  return true;
+}
+
+// Everything the file added, in order, with nested files as INCLUDE records
+static bool put_records(writer_t* w, const include_frame_t* frame,
+                        uint32_t* count) {
+  const int end = get_dictionary_size();
+  int nested = 0;
+  *count = 0;
+  for (int i = frame->start; i <= end; i++) {
+    while (nested < frame->include_count &&
+           i == frame->includes[nested].start) {
+      put_u8(w, RECORD_INCLUDE);
+      put_text(w, frame->includes[nested].path);
+      put_u64(w, frame->includes[nested].key);
+      i = frame->includes[nested++].end;
+      (*count)++;
+    }
+    if (i >= end) break;
+    if (!put_define(w, frame, get_dictionary_entry(i))) return false;
+    (*count)++;
+  }
+  return true;
+}
+
+// Cache what the file added, returning its key
+static uint64_t save_cache(const char* cache_path, const include_frame_t* frame,
+                           uint64_t source_hash) {
+  writer_t body = {0};
+  uint32_t record_count;
+  import_count = 0;
+  if (!put_records(&body, frame, &record_count) || body.failed) {
+    metal_free(body.data);
+    return session_key();
+  }
+
+  uint64_t key = hash_u64(source_hash, FNV_OFFSET);
+  for (int i = 0; i < import_count; i++) {
+    key = hash_u64(entry_hash(get_dictionary_entry(import_entries[i])), key);
+  }
+  for (int i = 0; i < frame->include_count; i++) {
+    key = hash_u64(frame->includes[i].key, key);
+  }
+
+  writer_t w = {0};
+  put_u32(&w, CACHE_MAGIC);
+  put_u32(&w, CACHE_VERSION);
+  put_u32(&w, sizeof(cell_t));
+  put_text(&w, METAL_VERSION);
+  put_u64(&w, source_hash);
+  put_u64(&w, key);
+  put_u32(&w, (uint32_t)import_count);
+  for (int i = 0; i < import_count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(import_entries[i]);
+    put_text(&w, entry->name);
+    put_u64(&w, entry_hash(entry));
+  }
+  put_u32(&w, record_count);
+  put_u64(&w, fnv1a(body.data, body.length, FNV_OFFSET));
+  put(&w, body.data, body.length);
+
+  // A file that cannot be written just stays uncached
+  FILE* file = w.failed ? NULL : fopen(cache_path, "wb");
+  if (file) {
+    const bool written = fwrite(w.data, 1, w.length, file) == w.length;
+    if (fclose(file) != 0 || !written) remove(cache_path);
+  }
+
+  metal_free(body.data);
+  metal_free(w.data);
+  return key;
+}
+
+// Reading. Caches are untrusted input: any inconsistency is a miss.
+
+typedef struct {
+  const uint8_t* data;
+  size_t length;
+  size_t pos;
+  bool ok;
+} reader_t;
+
+static const void* take(reader_t* r, size_t length) {
+  if (!r->ok || length > r->length - r->pos) {
+    r->ok = false;
+    return NULL;
+  }
+  const void* bytes = r->data + r->pos;
+  r->pos += length;
+  return bytes;
+}
+
+static uint8_t get_u8(reader_t* r) {
+  const uint8_t* bytes = take(r, 1);
+  return bytes ? *bytes : 0;
+}
+
+static uint32_t get_u32(reader_t* r) {
+  uint32_t value = 0;
+  const void* bytes = take(r, 4);
+  if (bytes) memcpy(&value, bytes, 4);
+  return value;
+}
+
+static uint64_t get_u64(reader_t* r) {
+  uint64_t value = 0;
+  const void* bytes = take(r, 8);
+  if (bytes) memcpy(&value, bytes, 8);
+  return value;
+}
+
+static const char* get_text(reader_t* r, size_t* length) {
+  *length = get_u32(r);
+  return take(r, *length);
+}
+
+// Terminated copy of a text field (caller frees)
+static char* get_string(reader_t* r) {
+  size_t length;
+  const char* text = get_text(r, &length);
+  if (!text) return NULL;
+
+  char* copy = metal_alloc(length + 1);
+  if (copy) {
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+  }
+  return copy;
+}
+
+static uint8_t* read_cache(const char* cache_path, size_t* length) {
+  FILE* file = fopen(cache_path, "rb");
+  if (!file) return NULL;
+
+  uint8_t* data = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    const long size = ftell(file);
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+      data = metal_alloc((size_t)size);
+      if (data && fread(data, 1, (size_t)size, file) != (size_t)size) {
+        metal_free(data);
+        data = NULL;
+      }
+      *length = (size_t)size;
+    }
+  }
+  fclose(file);
+  return data;
+}
+
+typedef struct {
+  reader_t reader;
+  include_frame_t* frame;
+  const dictionary_entry_t** imports;
+  uint32_t import_count;
+} cache_load_t;
+
+static const dictionary_entry_t* get_ref(cache_load_t* load, uint8_t kind) {
+  const uint32_t index = get_u32(&load->reader);
+  if (kind == REF_IMPORT) {
+    return index < load->import_count ? load->imports[index] : NULL;
+  }
+  if (kind == REF_LOCAL && index < (uint32_t)(get_dictionary_size() -
+                                              load->frame->start)) {
+    return get_dictionary_entry(load->frame->start + (int)index);
+  }
+  return NULL;
+}
+
+static bool get_cell(cache_load_t* load, code_data_t* code, cell_t* cell) {
+  reader_t* r = &load->reader;
+  const cell_type_t type = get_u8(r);
+  const cell_flags_t flags = get_u8(r);
+  size_t length;
+
+  switch (type) {
+    case CELL_INT32:
+    case CELL_INT64:
+    case CELL_FLOAT:
+    case CELL_FLOAT32:
+    case CELL_FIXED: {
+      const void* payload = take(r, sizeof(cell->payload));
+      if (!payload) return false;
+      memcpy(&cell->payload, payload, sizeof(cell->payload));
+      break;
+    }
+    case CELL_STRING: {
+      const char* text = get_text(r, &length);
+      if (!text) return false;
+      *cell = new_string_span(text, length);
+      break;
+    }
+    case CELL_BIGINT: {
+      char* digits = get_string(r);
+      const bool parsed = digits && parse_bigint(digits, cell);
+      metal_free(digits);
+      if (!parsed) return false;
+      break;
+    }
+    case CELL_NATIVE: {
+      const uint8_t kind = get_u8(r);
+      if (kind == REF_EXIT) {
+        cell->payload.native = native_exit;
+      } else if (kind == REF_BRANCH) {
+        cell->payload.native = native_branch;
+      } else if (kind == REF_ZBRANCH) {
+        cell->payload.native = native_zbranch;
+      } else {
+        const dictionary_entry_t* entry = get_ref(load, kind);
+        if (!entry || entry->definition.type != CELL_NATIVE) return false;
+        cell->payload.native =
+            learning_variant(entry->definition.payload.native);
+      }
+      break;
+    }
+    case CELL_CODE: {
+      const uint8_t kind = get_u8(r);
+      if (kind == REF_SELF) {
+        cell->payload.ptr = code;
+        break;
+      }
+      const dictionary_entry_t* entry = get_ref(load, kind);
+      if (!entry || entry->definition.type != CELL_CODE) return false;
+      cell->payload.ptr = entry->definition.payload.ptr;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  cell->type = type;
+  cell->flags = flags;
+  if (type == CELL_CODE) metal_retain(cell);
+  return r->ok;
+}
+
+// Link sites must lie in order within the code, before its EXIT
+static link_site_t* get_links(cache_load_t* load, uint32_t code_length,
+                              uint32_t* count) {
+  reader_t* r = &load->reader;
+  *count = get_u32(r);
+  if (!r->ok || *count > (r->length - r->pos) / 13) return NULL;
+
+  link_site_t* links = metal_alloc(*count * sizeof(link_site_t) + 1);
+  if (!links) return NULL;
+
+  uint32_t end = 0;
+  for (uint32_t i = 0; i < *count; i++) {
+    links[i].position = get_u32(r);
+    links[i].length = get_u32(r);
+    const dictionary_entry_t* entry = get_ref(load, get_u8(r));
+    if (!entry || links[i].position < end ||
+        links[i].position >= code_length ||
+        links[i].length >= code_length - links[i].position) {
+      metal_free(links);
+      return NULL;
+    }
+    links[i].entry = get_entry_index(entry);
+    end = links[i].position + links[i].length;
+  }
+  return links;
+}
+
+// Every branch must land inside the code and the code must end in EXIT, as
+// the threaded and register engines assume without checking
+static bool valid_body(const code_data_t* code) {
+  const cell_t* cells = code->instructions;
+  const size_t length = code->length;
+  for (size_t i = 0; i < length; i++) {
+    if (cells[i].type != CELL_NATIVE ||
+        (cells[i].payload.native != native_branch &&
+         cells[i].payload.native != native_zbranch)) {
+      continue;
+    }
+    if (++i >= length || cells[i].type != CELL_INT32) return false;
+    const int64_t target = (int64_t)i + cells[i].payload.i32;
+    if (target < 0 || target >= (int64_t)length) return false;
+  }
+  return cells[length - 1].type == CELL_NATIVE &&
+         cells[length - 1].payload.native == native_exit;
+}
+
+static bool get_define(cache_load_t* load) {
+  reader_t* r = &load->reader;
+  size_t name_length;
+  const char* name = get_text(r, &name_length);
+  char* help = get_string(r);
+  const uint32_t length = get_u32(r);
+
+  // Every cell takes at least two bytes, which bounds the allocation
+  if (!name || !help || name_length > MAX_NAME_LENGTH ||
+      length == 0 || length > (r->length - r->pos) / 2) {
+    metal_free(help);
+    return false;
+  }
+
+  code_data_t* code = create_code_data(length);
+  if (!code) {
+    metal_free(help);
+    return false;
+  }
+  memset(code->instructions, 0, length * sizeof(cell_t));
+
+  cell_t definition = new_code(code);
+  for (uint32_t i = 0; i < length; i++) {
+    if (!get_cell(load, code, &code->instructions[i])) {
+      metal_release(&definition);
+      metal_free(help);
+      return false;
+    }
+  }
+  if (!valid_body(code)) {
+    metal_release(&definition);
+    metal_free(help);
+    return false;
+  }
+
+  // Redefining a word other code links to needs a relink, which only
+  // compiling does
+  char entry_name[MAX_NAME_LENGTH + 1];
+  memcpy(entry_name, name, name_length);
+  entry_name[name_length] = '\0';
+  const dictionary_entry_t* shadowed = find_current_word(entry_name);
+  uint32_t dependent_count = 0;
+  if (shadowed) get_dependents(get_entry_index(shadowed), &dependent_count);
+
+  uint32_t link_count;
+  link_site_t* links = get_links(load, length, &link_count);
+  if (!links || dependent_count > 0) {
+    metal_free(links);
+    metal_release(&definition);
+    metal_free(help);
+    return false;
+  }
+
+  add_code_word(entry_name, definition, help);
+  set_word_links(get_dictionary_size() - 1, links, link_count);
+  return true;
+}
+
+static bool get_include(context_t* ctx, cache_load_t* load) {
+  char* path = get_string(&load->reader);
+  const uint64_t expected = get_u64(&load->reader);
+  if (!path || !load->reader.ok) {
+    metal_free(path);
+    return false;
+  }
+
+  // A nested file that changed invalidates everything compiled after it
+  uint64_t key;
+  const bool loaded = include_file(ctx, path, &key) && key == expected;
+  metal_free(path);
+  return loaded;
+}
+
+static bool replay_cache(context_t* ctx, cache_load_t* load,
+                         uint64_t source_hash, uint64_t* key) {
+  reader_t* r = &load->reader;
+  size_t length;
+
+  if (get_u32(r) != CACHE_MAGIC || get_u32(r) != CACHE_VERSION ||
+      get_u32(r) != sizeof(cell_t)) {
+    return false;
+  }
+  const char* version = get_text(r, &length);
+  if (!version || length != strlen(METAL_VERSION) ||
+      memcmp(version, METAL_VERSION, length) != 0 ||
+      get_u64(r) != source_hash) {
+    return false;
+  }
+  *key = get_u64(r);
+
+  // Every import must still name the entry the file was compiled against
+  load->import_count = get_u32(r);
+  if (load->import_count > MAX_IMPORTS) return false;
+  for (uint32_t i = 0; i < load->import_count; i++) {
+    const char* name = get_text(r, &length);
+    const uint64_t hash = get_u64(r);
+    const dictionary_entry_t* entry =
+        name ? find_word_span(name, length) : NULL;
+    if (!entry || entry_hash(entry) != hash) return false;
+    load->imports[i] = entry;
+  }
+
+  // The body is checked whole, so a corrupted name or literal is a miss
+  // rather than a wrong definition
+  const uint32_t record_count = get_u32(r);
+  const uint64_t checksum = get_u64(r);
+  if (!r->ok ||
+      fnv1a(r->data + r->pos, r->length - r->pos, FNV_OFFSET) != checksum) {
+    return false;
+  }
+  for (uint32_t i = 0; i < record_count && r->ok; i++) {
+    const uint8_t kind = get_u8(r);
+    const bool replayed = kind == RECORD_DEFINE    ? get_define(load)
+                          : kind == RECORD_INCLUDE ? get_include(ctx, load)
+                                                   : false;
+    if (!replayed) return false;
+  }
+  return r->ok && r->pos == r->length;
+}
+
+// Replay a valid cache, leaving the dictionary untouched otherwise
+static bool load_cache(context_t* ctx, const char* cache_path,
+                       uint64_t source_hash, include_frame_t* frame,
+                       uint64_t* key) {
+  size_t length = 0;
+  uint8_t* data = read_cache(cache_path, &length);
+  if (!data) return false;
+
+  cache_load_t load = {.reader = {data, length, 0, true}, .frame = frame};
+  load.imports = metal_alloc(MAX_IMPORTS * sizeof(dictionary_entry_t*));
+  const bool loaded =
+      load.imports && replay_cache(ctx, &load, source_hash, key);
+  metal_free(load.imports);
+  metal_free(data);
+
+  if (!loaded) {
+    forget_words(frame->start);
+    for (int i = 0; i < frame->include_count; i++) {
+      metal_free(frame->includes[i].path);
+    }
+    frame->include_count = 0;
+    frame->cacheable = true;
+  }
+  return loaded;
+}
+
+// Loading
+
+bool interpret_nested(context_t* ctx, const char* source) {
+  jmp_buf saved_jmp;
+  memcpy(saved_jmp, ctx->error_jmp, sizeof(jmp_buf));
+  const char* saved_pos = ctx->input_pos;
+  const char* saved_start = ctx->input_start;
+
+  const metal_result_t result = interpret(source);
+
+  memcpy(ctx->error_jmp, saved_jmp, sizeof(jmp_buf));
+  ctx->input_pos = saved_pos;
+  ctx->input_start = saved_start;
+  return result == METAL_OK;
+}
+
+// Record a nested file in the one including it
+static void note_include(include_frame_t* parent, const char* path, int start,
+                         uint64_t key, bool cacheable) {
+  if (!cacheable || parent->include_count >= MAX_NESTED_INCLUDES) {
+    parent->cacheable = false;
+    return;
+  }
+
+  char* copy = metal_alloc(strlen(path) + 1);
+  if (!copy) return;
+  strcpy(copy, path);
+
+  nested_include_t* nested = &parent->includes[parent->include_count++];
+  nested->path = copy;
+  nested->start = start;
+  nested->end = get_dictionary_size();
+  nested->key = key;
+}
+
+// Load a file, from its cache when still valid. Errors are left in
+// include_error rather than raised, so replaying a cache can back out.
+static bool include_file(context_t* ctx, const char* path, uint64_t* key) {
+  if (include_depth >= MAX_INCLUDE_DEPTH) {
+    snprintf(include_error, sizeof(include_error), "%s nested too deeply",
+             path);
+    return false;
+  }
+
+  source_file_t file;
+  if (!open_source_file(path, &file)) {
+    snprintf(include_error, sizeof(include_error), "cannot read %s", path);
+    return false;
+  }
+  const uint64_t source_hash = fnv1a(file.text, file.length, FNV_OFFSET);
+
+  char* cache_path = metal_alloc(strlen(path) + sizeof(CACHE_SUFFIX));
+  if (!cache_path) {
+    close_source_file(&file);
+    snprintf(include_error, sizeof(include_error), "out of memory");
+    return false;
+  }
+  strcpy(cache_path, path);
+  strcat(cache_path, CACHE_SUFFIX);
+
+  include_frame_t frame = {.parent = current_frame,
+                           .start = get_dictionary_size(),
+                           .cacheable = true};
+  current_frame = &frame;
+  include_depth++;
+
+  bool ok = true;
+  bool cacheable = true;
+  if (load_cache(ctx, cache_path, source_hash, &frame, key)) {
+    trace(TRACE_INCLUDE_REPLAY);
+  } else {
+    const uint32_t effects = top_level_effects();
+    const uint32_t relinks = get_relink_count();
+    ok = interpret_nested(ctx, file.text);
+    if (!ok) {
+      snprintf(include_error, sizeof(include_error), "error in %s", path);
+    } else if (is_compiling()) {
+      abort_compilation();
+      snprintf(include_error, sizeof(include_error),
+               "unterminated definition in %s", path);
+      ok = false;
+    } else {
+      // Relinking changed code the file does not own
+      cacheable = frame.cacheable && top_level_effects() == effects &&
+                  get_relink_count() == relinks;
+      *key = cacheable ? save_cache(cache_path, &frame, source_hash)
+                       : session_key();
+      trace(TRACE_INCLUDE_COMPILE, cacheable);
+    }
+  }
+
+  if (ok) assign_hashes(&frame, *key);
+  for (int i = 0; i < frame.include_count; i++) {
+    metal_free(frame.includes[i].path);
+  }
+  include_depth--;
+  current_frame = frame.parent;
+  close_source_file(&file);
+  metal_free(cache_path);
+
+  if (ok && current_frame) {
+    note_include(current_frame, path, frame.start, *key, cacheable);
+  }
+  return ok;
+}
+
+// INCLUDE ( -- ) Load the source file named by the next token
+static void native_include(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) == TOKEN_EOF) {
+    error("INCLUDE : missing file name");
+    return;
+  }
+  if (name.length >= MAX_PATH_LENGTH) {
+    error("INCLUDE : file name too long");
+    return;
+  }
+
+  char path[MAX_PATH_LENGTH];
+  memcpy(path, name.start, name.length);
+  path[name.length] = '\0';
+
+  uint64_t key;
+  if (!include_file(ctx, path, &key)) {
+    error("INCLUDE : %s", include_error);
+  }
+}
+
+// Source loading words
+static const dictionary_entry_t loader_entries[] = {
+    DEFINING_WORD("INCLUDE", native_include,
+                  "( -- ) Load the source file named next, cached"),
+};
+const word_table_t loader_words = WORD_TABLE(loader_entries);
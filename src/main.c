@@ -10,19 +10,35 @@
 #include "pico/stdlib.h"
 #endif
 
+#include "bench.h"
 #include "cell.h"
+#include "code.h"
+#include "compiler.h"
 #include "core.h"
-#include "debug.h"
 #include "dictionary.h"
+#include "epoch.h"
+#include "fixed.h"
+#include "image.h"
+#include "ir.h"
+#include "loader.h"
+#include "math.h"
 #include "memory.h"
 #include "metal.h"
+#include "metal2c.h"
+#include "output.h"
 #include "parser.h"
+#include "profile.h"
 #include "repl.h"
+#include "sampler.h"
+#include "source_file.h"
 #include "stack.h"
 #include "tools.h"
+#include "trace.h"
+#include "vocabulary.h"
 
 // Global state
 static context_t main_context;
+static uint32_t effect_count;
 
 // Context management
 void init_context(context_t* ctx) {
@@ -50,35 +66,27 @@ void error(const char* fmt, ...) {
     metal_release(&cell);
   }
 
+  // Abandon any threaded code and partial definition
+  main_context.ip = nullptr;
+  abort_compilation();
+
   main_context.error_msg = error_buffer;
   longjmp(main_context.error_jmp, 1);
 }
 
-// Number parsing
-bool try_parse_number(const char* token, cell_t* result) {
-  char* endptr;
-
-  // Try integer first
-  const long long val = strtoll(token, &endptr, 10);
-
-  if (*endptr == '\0') {
-    if (val >= INT32_MIN && val <= INT32_MAX) {
-      *result = new_int32((int32_t)val);
-    } else {
-      *result = new_int64(val);
-    }
-    return true;
-  }
+uint32_t top_level_effects(void) { return effect_count; }
 
-  // Try float
-  const double fval = strtod(token, &endptr);
+// Lines interpreted inside the current one, through INCLUDE
+static int interpret_depth;
 
-  if (*endptr == '\0') {
-    *result = new_float(fval);
-    return true;
+// The REPL updates the dictionary, and holds nothing it retired once a
+// top-level line is done (see epoch.h)
+static void finish_line(void) {
+  if (--interpret_depth == 0) {
+    epoch_reclaim();
+    profile_unwind();  // Calls an error left open
+    output_flush();
   }
-
-  return false;
 }
 
 // Main interpreter
@@ -86,53 +94,66 @@ metal_result_t interpret(const char* input) {
   // Set up exception handling
   if (setjmp(main_context.error_jmp) != 0) {
     // We jumped here due to an error
-    printf("ERROR: %s\n", main_context.error_msg);
+    output_format("ERROR: %s\n", main_context.error_msg);
 
     // Clear parsing state
     main_context.input_pos = nullptr;
     main_context.input_start = nullptr;
 
+    finish_line();
     return METAL_ERROR;
   }
+  interpret_depth++;
 
   // Set up parsing state in context
   main_context.input_start = input;
   main_context.input_pos = input;
 
-  char token_buffer[256];
-  token_type_t token_type;
-
-  // Parse and execute tokens one at a time
-  while ((token_type = parse_next_token(&main_context.input_pos, token_buffer,
-                                        sizeof(token_buffer))) != TOKEN_EOF) {
-    if (token_type == TOKEN_STRING) {
-      // String literal - push to stack
-      data_push(&main_context, new_string(token_buffer));
-
-    } else if (token_type == TOKEN_WORD) {
-      char* word = token_buffer;
+  token_t token;
+
+  // Parse and execute tokens one at a time, as spans of the input
+  while (parse_next_token(&main_context.input_pos, &token) != TOKEN_EOF) {
+    if (token.type == TOKEN_STRING) {
+      // String literal - push to stack or compile
+      if (is_compiling()) {
+        compile_literal(token_string(&token));
+      } else {
+        effect_count++;
+        data_push(&main_context, token_string(&token));
+      }
 
+    } else if (token.type == TOKEN_WORD) {
       // Try to parse as number
       cell_t num;
-      if (try_parse_number(word, &num)) {
-        data_push(&main_context, num);
+      if (try_parse_number(token.start, token.length, &num)) {
+        if (is_compiling()) {
+          compile_literal(num);
+        } else {
+          effect_count++;
+          data_push(&main_context, num);
+        }
         continue;
       }
 
       // Try to find in dictionary
-      const dictionary_entry_t* dict_word = find_word(word);
+      const dictionary_entry_t* dict_word =
+          find_word_span(token.start, token.length);
 
       if (dict_word) {
-        if (dict_word->definition.type == CELL_NATIVE) {
-          dict_word->definition.payload.native(&main_context);
+        if (is_compiling() && !(dict_word->flags & WORD_FLAG_IMMEDIATE)) {
+          compile_word(dict_word);
         } else {
-          error("Non-native words not implemented yet");
+          if (!is_compiling() && !(dict_word->flags & (WORD_FLAG_IMMEDIATE |
+                                                        WORD_FLAG_DEFINING))) {
+            effect_count++;
+          }
+          execute(&main_context, &dict_word->definition);
         }
         continue;
       }
 
       // Unknown word
-      error("Unknown word: %s\n", word);
+      error("Unknown word: %.*s\n", (int)token.length, token.start);
     }
   }
 
@@ -140,21 +161,80 @@ metal_result_t interpret(const char* input) {
   main_context.input_pos = nullptr;
   main_context.input_start = nullptr;
 
+  finish_line();
   return METAL_OK;
 }
 
-// Initialize built-in words
-void populate_dictionary(void) {
-  add_core_words();   // Core language features
-  add_tools_words();  // Development tools
-
-  // Debug words (only when debug support compiled in)
+// Built-in words in lookup order, each table shadowing the ones before it
+static const word_table_t* const builtin_words[] = {
+    &core_words,        // Core language features
+    &math_words,        // Numeric tower
+    &fixed_words,       // Fixed-point signal processing
+    &compiler_words,    // Colon definitions and control flow
+    &vocabulary_words,  // Wordlists and the search order
+    &ir_words,          // Register VM
+    &loader_words,      // INCLUDE
+    &image_words,       // SAVE-IMAGE
+    &tools_words,       // Development tools
+    &output_words,      // FLUSH
+    &profile_words,     // PROFILE-ON and PROFILE-REPORT
+    &sampler_words,     // SAMPLE-ON and SAMPLE-SAVE
 #ifdef DEBUG_ENABLED
-  add_debug_words();  // Debug commands
+    &trace_words,  // TRACE-ON and TRACE-SAVE
+    &epoch_words,  // EPOCH-CHECK
+#endif
+#ifdef BENCH_ENABLED
+    &bench_words,  // Microbenchmarks
+#endif
+#ifdef MEM_STATS_ENABLED
+    &memory_words,  // MEM-STATS
+#endif
+#ifdef METAL_AOT
+    &compiled_words,  // Definitions translated ahead of time by metal2c
 #endif
+};
+
+#if !defined(TARGET_PICO) && !defined(METAL_ENTRY_WORD)
+// Interpret source to the end; an unterminated definition is an error too
+static bool run_source(const char* source, const char* origin) {
+  if (interpret(source) != METAL_OK) return false;
+  if (is_compiling()) {
+    fprintf(stderr, "%s: unterminated definition\n", origin);
+    abort_compilation();
+    return false;
+  }
+  return true;
+}
+
+// Script mode: metal [-e code | file]... runs each in order without the
+// terminal or history, stopping at the first error. The exit status is 0
+// on success, 1 when a script fails and 2 for bad arguments.
+static int run_scripts(int argc, char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    bool ok;
+    if (strcmp(argv[i], "-e") == 0) {
+      if (++i == argc) {
+        fprintf(stderr, "metal: -e needs an argument\n");
+        return 2;
+      }
+      ok = run_source(argv[i], "-e");
+    } else {
+      source_file_t file;
+      if (!open_source_file(argv[i], &file)) {
+        fprintf(stderr, "metal: cannot read %s\n", argv[i]);
+        return 2;
+      }
+      ok = run_source(file.text, argv[i]);
+      close_source_file(&file);
+    }
+
+    if (!ok) return 1;
+  }
+  return 0;
 }
+#endif
 
-int main(void) {
+int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
 #ifdef TARGET_PICO
   stdio_init_all();
 
@@ -170,15 +250,56 @@ int main(void) {
 #define TARGET "Windows"
 #endif
 
-  printf("Metal Language v" METAL_VERSION " - " TARGET "\n");
-  printf("Type 'bye' to exit, '.s' to show stack\n\n");
-  printf("Cell size: %lu\n", sizeof(cell_t));
-
   // Initialize system
   init_memory();
+  atexit(output_flush);
   init_context(&main_context);
-  init_dictionary();  // Initialize dictionary first
-  populate_dictionary();
+  init_dictionary(builtin_words,
+                  sizeof(builtin_words) / sizeof(builtin_words[0]));
+#ifdef METAL_AOT
+  init_compiled_words();
+#endif
+  init_image();
+
+#ifdef METAL_ENTRY_WORD
+  // Tree-shaken firmware runs its entry word; the REPL is not linked in
+  return interpret(METAL_ENTRY_WORD) == METAL_OK ? 0 : 1;
+#else
+#ifndef TARGET_PICO
+  // Ahead-of-time translation: metal --metal2c input.mtl output.c
+  // [--entry WORD]
+  if ((argc == 4 || (argc == 6 && strcmp(argv[4], "--entry") == 0)) &&
+      strcmp(argv[1], "--metal2c") == 0) {
+    return metal2c(argv[2], argv[3], argc == 6 ? argv[5] : NULL);
+  }
+
+#ifdef DEBUG_ENABLED
+  // Print a trace written by TRACE-SAVE: metal --trace trace.bin
+  if (argc == 3 && strcmp(argv[1], "--trace") == 0) {
+    return decode_trace(argv[2]);
+  }
+#endif
+
+  // Boot from a snapshot: metal --image app.img [script...]
+  if (argc > 2 && strcmp(argv[1], "--image") == 0) {
+    image_file_t image;  // Mapped for the life of the process
+    const char* failure = load_image(argv[2], &image);
+    if (failure) {
+      fprintf(stderr, "metal: %s: %s\n", argv[2], failure);
+      return 2;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (argc > 1) return run_scripts(argc, argv);
+#endif
+
+  output_text("Metal Language v" METAL_VERSION " - " TARGET "\n");
+  output_text("Type 'bye' to exit, '.s' to show stack\n\n");
+  output_format("Cell size: %lu\n", sizeof(cell_t));
+
   repl(&main_context);
   return 0;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,724 @@
+#include "math.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bigint.h"
+#include "dictionary.h"
+#include "fixed.h"
+#include "memory.h"
+#include "metal.h"
+
+// Numeric types in promotion order. Every binary operation has a table
+// indexed by the types of its two operands, so dispatch is two lookups
+// rather than a chain of type tests.
+typedef enum {
+  NUMERIC_INT32,
+  NUMERIC_INT64,
+  NUMERIC_BIGINT,
+  NUMERIC_FIXED,
+  NUMERIC_FLOAT32,
+  NUMERIC_FLOAT,
+  NUMERIC_TYPES,
+} numeric_type_t;
+
+typedef cell_t (*numeric_func_t)(const cell_t* a, const cell_t* b);
+
+typedef struct {
+  const char* name;
+  numeric_func_t table[NUMERIC_TYPES][NUMERIC_TYPES];
+} numeric_op_t;
+
+static int numeric_type(cell_type_t type) {
+  switch (type) {
+    case CELL_INT32:
+      return NUMERIC_INT32;
+    case CELL_INT64:
+      return NUMERIC_INT64;
+    case CELL_BIGINT:
+      return NUMERIC_BIGINT;
+    case CELL_FIXED:
+      return NUMERIC_FIXED;
+    case CELL_FLOAT32:
+      return NUMERIC_FLOAT32;
+    case CELL_FLOAT:
+      return NUMERIC_FLOAT;
+    default:
+      return -1;
+  }
+}
+
+static int64_t as_int64(const cell_t* cell) {
+  return cell->type == CELL_INT32 ? cell->payload.i32 : cell->payload.i64;
+}
+
+static double as_float(const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_INT32:
+      return cell->payload.i32;
+    case CELL_INT64:
+      return (double)cell->payload.i64;
+    case CELL_BIGINT:
+      return bigint_to_float(cell->payload.ptr);
+    case CELL_FIXED:
+      return fixed_to_double(cell->payload.fixed);
+    case CELL_FLOAT32:
+      return cell->payload.f32;
+    default:
+      return cell->payload.f;
+  }
+}
+
+bool is_number(const cell_t* cell) { return numeric_type(cell->type) >= 0; }
+
+// A bigint is always beyond the fixed-point range
+int32_t cell_to_fixed(const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_FIXED:
+      return cell->payload.fixed;
+    case CELL_INT32:
+      return fixed_from_int64(cell->payload.i32);
+    case CELL_INT64:
+      return fixed_from_int64(cell->payload.i64);
+    case CELL_BIGINT:
+      return ((const bigint_data_t*)cell->payload.ptr)->negative ? INT32_MIN
+                                                                 : INT32_MAX;
+    default:
+      return fixed_from_double(as_float(cell));
+  }
+}
+
+static float as_float32(const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_FLOAT32:
+      return cell->payload.f32;
+    case CELL_INT32:
+      return (float)cell->payload.i32;
+    default:
+      return (float)as_float(cell);
+  }
+}
+
+cell_t new_integer(int64_t value) {
+  if (value >= INT32_MIN && value <= INT32_MAX) {
+    return new_int32((int32_t)value);
+  }
+  return new_int64(value);
+}
+
+cell_t new_flag(bool value) { return new_int32(value ? -1 : 0); }
+
+static cell_t dispatch(const numeric_op_t* op, const cell_t* a,
+                       const cell_t* b) {
+  int x = numeric_type(a->type);
+  int y = numeric_type(b->type);
+  if (x < 0 || y < 0) {
+    error("%s : type mismatch", op->name);
+    return new_empty();
+  }
+  return op->table[x][y](a, b);
+}
+
+// Addition, subtraction and multiplication. An int32 result that
+// overflows is recomputed exactly in int64 and an int64 result that
+// overflows in a bigint. Bigint results that fit are demoted again.
+// Fixed-point results saturate.
+
+#define CHECKED_OPERATION(name, op, builtin)                          \
+  static cell_t name##_int32(const cell_t* a, const cell_t* b) {      \
+    int32_t result;                                                   \
+    if (builtin(a->payload.i32, b->payload.i32, &result)) {           \
+      return new_int64((int64_t)a->payload.i32 op b->payload.i32);    \
+    }                                                                 \
+    return new_int32(result);                                         \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_int64(const cell_t* a, const cell_t* b) {      \
+    int64_t result;                                                   \
+    if (builtin(as_int64(a), as_int64(b), &result)) {                 \
+      return bigint_##name(a, b);                                     \
+    }                                                                 \
+    return new_integer(result);                                       \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_bigint(const cell_t* a, const cell_t* b) {     \
+    return bigint_##name(a, b);                                       \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_fixed(const cell_t* a, const cell_t* b) {      \
+    return new_fixed(fixed_##name(cell_to_fixed(a), cell_to_fixed(b))); \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_float32(const cell_t* a, const cell_t* b) {    \
+    return new_float32(as_float32(a) op as_float32(b));               \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_float(const cell_t* a, const cell_t* b) {      \
+    return new_float(as_float(a) op as_float(b));                     \
+  }
+
+CHECKED_OPERATION(add, +, __builtin_add_overflow)
+CHECKED_OPERATION(subtract, -, __builtin_sub_overflow)
+CHECKED_OPERATION(multiply, *, __builtin_mul_overflow)
+
+// Integer division truncates toward zero. The one quotient that overflows,
+// MIN / -1, is promoted like any other overflow.
+
+static cell_t divide_int32(const cell_t* a, const cell_t* b) {
+  if (b->payload.i32 == 0) {
+    error("/ : division by zero");
+    return new_empty();
+  }
+  if (a->payload.i32 == INT32_MIN && b->payload.i32 == -1) {
+    return new_int64(-(int64_t)INT32_MIN);
+  }
+  return new_int32(a->payload.i32 / b->payload.i32);
+}
+
+static cell_t divide_int64(const cell_t* a, const cell_t* b) {
+  int64_t x = as_int64(a);
+  int64_t y = as_int64(b);
+  if (y == 0) {
+    error("/ : division by zero");
+    return new_empty();
+  }
+  if (x == INT64_MIN && y == -1) return bigint_divide(a, b);
+  return new_integer(x / y);
+}
+
+// A bigint is never zero, so only a narrower divisor can be
+static bool is_zero(const cell_t* cell) {
+  return cell->type == CELL_INT32   ? cell->payload.i32 == 0
+         : cell->type == CELL_INT64 ? cell->payload.i64 == 0
+                                    : false;
+}
+
+static cell_t divide_bigint(const cell_t* a, const cell_t* b) {
+  if (is_zero(b)) {
+    error("/ : division by zero");
+    return new_empty();
+  }
+  return bigint_divide(a, b);
+}
+
+static cell_t divide_fixed(const cell_t* a, const cell_t* b) {
+  const int32_t divisor = cell_to_fixed(b);
+  if (divisor == 0) {
+    error("/ : division by zero");
+    return new_empty();
+  }
+  return new_fixed(fixed_divide(cell_to_fixed(a), divisor));
+}
+
+static cell_t divide_float32(const cell_t* a, const cell_t* b) {
+  return new_float32(as_float32(a) / as_float32(b));
+}
+
+static cell_t divide_float(const cell_t* a, const cell_t* b) {
+  return new_float(as_float(a) / as_float(b));
+}
+
+// The remainder takes the sign of the dividend
+
+static cell_t mod_int32(const cell_t* a, const cell_t* b) {
+  if (b->payload.i32 == 0) {
+    error("MOD : division by zero");
+    return new_empty();
+  }
+  if (b->payload.i32 == -1) return new_int32(0);  // Avoids MIN % -1
+  return new_int32(a->payload.i32 % b->payload.i32);
+}
+
+static cell_t mod_int64(const cell_t* a, const cell_t* b) {
+  int64_t x = as_int64(a);
+  int64_t y = as_int64(b);
+  if (y == 0) {
+    error("MOD : division by zero");
+    return new_empty();
+  }
+  if (y == -1) return new_int32(0);
+  return new_integer(x % y);
+}
+
+static cell_t mod_bigint(const cell_t* a, const cell_t* b) {
+  if (is_zero(b)) {
+    error("MOD : division by zero");
+    return new_empty();
+  }
+  return bigint_mod(a, b);
+}
+
+static cell_t mod_fixed(const cell_t* a, const cell_t* b) {
+  const int32_t divisor = cell_to_fixed(b);
+  if (divisor == 0) {
+    error("MOD : division by zero");
+    return new_empty();
+  }
+  if (divisor == -1) return new_fixed(0);  // Avoids MIN % -1
+  return new_fixed(cell_to_fixed(a) % divisor);
+}
+
+static cell_t mod_float32(const cell_t* a, const cell_t* b) {
+  return new_float32(__builtin_fmodf(as_float32(a), as_float32(b)));
+}
+
+static cell_t mod_float(const cell_t* a, const cell_t* b) {
+  return new_float(__builtin_fmod(as_float(a), as_float(b)));
+}
+
+// Comparisons. Integers against float compare as float; NaN is unordered,
+// so only <> holds for it.
+
+#define COMPARISON(name, op)                                          \
+  static cell_t name##_int32(const cell_t* a, const cell_t* b) {      \
+    return new_flag(a->payload.i32 op b->payload.i32);                \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_int64(const cell_t* a, const cell_t* b) {      \
+    return new_flag(as_int64(a) op as_int64(b));                      \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_bigint(const cell_t* a, const cell_t* b) {     \
+    return new_flag(bigint_compare(a, b) op 0);                       \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_float32(const cell_t* a, const cell_t* b) {    \
+    return new_flag(as_float32(a) op as_float32(b));                  \
+  }                                                                   \
+                                                                      \
+  static cell_t name##_float(const cell_t* a, const cell_t* b) {      \
+    return new_flag(as_float(a) op as_float(b));                      \
+  }                                                                   \
+                                                                      \
+  /* Exact: int32 and fixed both convert to double without loss */   \
+  static cell_t name##_fixed(const cell_t* a, const cell_t* b) {      \
+    return name##_float(a, b);                                        \
+  }
+
+COMPARISON(less, <)
+COMPARISON(greater, >)
+COMPARISON(equal, ==)
+COMPARISON(not_equal, !=)
+COMPARISON(less_equal, <=)
+COMPARISON(greater_equal, >=)
+
+// Type-pair tables. Each pair runs in whichever of its two types comes
+// later in promotion order.
+#define NUMERIC_OP(word, name)                                      \
+  static const numeric_op_t name##_op = {                           \
+      word,                                                         \
+      {                                                             \
+          {name##_int32, name##_int64, name##_bigint,               \
+           name##_fixed, name##_float32, name##_float},             \
+          {name##_int64, name##_int64, name##_bigint,               \
+           name##_fixed, name##_float32, name##_float},             \
+          {name##_bigint, name##_bigint, name##_bigint,             \
+           name##_fixed, name##_float32, name##_float},             \
+          {name##_fixed, name##_fixed, name##_fixed, name##_fixed,  \
+           name##_float32, name##_float},                           \
+          {name##_float32, name##_float32, name##_float32,          \
+           name##_float32, name##_float32, name##_float},           \
+          {name##_float, name##_float, name##_float, name##_float,  \
+           name##_float, name##_float},                             \
+      },                                                            \
+  };                                                                \
+                                                                    \
+  cell_t name##_cells(const cell_t* a, const cell_t* b) {           \
+    return dispatch(&name##_op, a, b);                              \
+  }
+
+NUMERIC_OP("+", add)
+NUMERIC_OP("-", subtract)
+NUMERIC_OP("*", multiply)
+NUMERIC_OP("/", divide)
+NUMERIC_OP("MOD", mod)
+NUMERIC_OP("<", less)
+NUMERIC_OP(">", greater)
+NUMERIC_OP("<=", less_equal)
+NUMERIC_OP(">=", greater_equal)
+
+// Equality also applies to non-numeric cells: strings compare by content,
+// everything else by identity
+static bool same_value(const cell_t* a, const cell_t* b) {
+  if (a->type != b->type) return false;
+
+  switch (a->type) {
+    case CELL_STRING:
+      return strcmp(a->payload.ptr, b->payload.ptr) == 0;
+    case CELL_NIL:
+    case CELL_EMPTY:
+    case CELL_NULL:
+    case CELL_UNDEFINED:
+      return true;
+    default:
+      return a->payload.ptr == b->payload.ptr;
+  }
+}
+
+static const numeric_op_t equal_op = {
+    "=",
+    {
+        {equal_int32, equal_int64, equal_bigint, equal_fixed, equal_float32,
+         equal_float},
+        {equal_int64, equal_int64, equal_bigint, equal_fixed, equal_float32,
+         equal_float},
+        {equal_bigint, equal_bigint, equal_bigint, equal_fixed, equal_float32,
+         equal_float},
+        {equal_fixed, equal_fixed, equal_fixed, equal_fixed, equal_float32,
+         equal_float},
+        {equal_float32, equal_float32, equal_float32, equal_float32,
+         equal_float32, equal_float},
+        {equal_float, equal_float, equal_float, equal_float, equal_float,
+         equal_float},
+    },
+};
+
+static const numeric_op_t not_equal_op = {
+    "<>",
+    {
+        {not_equal_int32, not_equal_int64, not_equal_bigint, not_equal_fixed,
+         not_equal_float32, not_equal_float},
+        {not_equal_int64, not_equal_int64, not_equal_bigint, not_equal_fixed,
+         not_equal_float32, not_equal_float},
+        {not_equal_bigint, not_equal_bigint, not_equal_bigint, not_equal_fixed,
+         not_equal_float32, not_equal_float},
+        {not_equal_fixed, not_equal_fixed, not_equal_fixed, not_equal_fixed,
+         not_equal_float32, not_equal_float},
+        {not_equal_float32, not_equal_float32, not_equal_float32,
+         not_equal_float32, not_equal_float32, not_equal_float},
+        {not_equal_float, not_equal_float, not_equal_float, not_equal_float,
+         not_equal_float, not_equal_float},
+    },
+};
+
+cell_t equal_cells(const cell_t* a, const cell_t* b) {
+  if (numeric_type(a->type) < 0 || numeric_type(b->type) < 0) {
+    return new_flag(same_value(a, b));
+  }
+  return dispatch(&equal_op, a, b);
+}
+
+cell_t not_equal_cells(const cell_t* a, const cell_t* b) {
+  if (numeric_type(a->type) < 0 || numeric_type(b->type) < 0) {
+    return new_flag(!same_value(a, b));
+  }
+  return dispatch(&not_equal_op, a, b);
+}
+
+// Words. The result replaces the two operands in place; an error leaves
+// the stack to error() untouched.
+
+static void binary_word(context_t* ctx, numeric_func_t func,
+                        const char* name) {
+  const int sp = ctx->data_stack_ptr;
+  if (sp < 2) {
+    error("%s : insufficient stack", name);
+    return;
+  }
+
+  cell_t* a = &ctx->data_stack[sp - 2];
+  cell_t* b = &ctx->data_stack[sp - 1];
+  cell_t result = func(a, b);
+
+  metal_release(a);
+  metal_release(b);
+  *a = result;
+  ctx->data_stack_ptr = sp - 1;
+}
+
+void native_add(context_t* ctx) { binary_word(ctx, add_cells, "+"); }
+
+void native_subtract(context_t* ctx) {
+  binary_word(ctx, subtract_cells, "-");
+}
+
+void native_multiply(context_t* ctx) {
+  binary_word(ctx, multiply_cells, "*");
+}
+
+void native_divide(context_t* ctx) { binary_word(ctx, divide_cells, "/"); }
+
+void native_mod(context_t* ctx) { binary_word(ctx, mod_cells, "MOD"); }
+
+void native_less(context_t* ctx) { binary_word(ctx, less_cells, "<"); }
+
+void native_greater(context_t* ctx) { binary_word(ctx, greater_cells, ">"); }
+
+void native_equal(context_t* ctx) { binary_word(ctx, equal_cells, "="); }
+
+void native_not_equal(context_t* ctx) {
+  binary_word(ctx, not_equal_cells, "<>");
+}
+
+void native_less_equal(context_t* ctx) {
+  binary_word(ctx, less_equal_cells, "<=");
+}
+
+void native_greater_equal(context_t* ctx) {
+  binary_word(ctx, greater_equal_cells, ">=");
+}
+
+// Conversion words
+
+static cell_t to_float32(const cell_t* cell) {
+  return new_float32(as_float32(cell));
+}
+
+static cell_t to_float(const cell_t* cell) { return new_float(as_float(cell)); }
+
+static cell_t to_fixed(const cell_t* cell) {
+  return new_fixed(cell_to_fixed(cell));
+}
+
+// Truncates toward zero
+static cell_t to_integer(const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_INT32:
+    case CELL_INT64:
+    case CELL_BIGINT: {
+      cell_t copy = *cell;
+      metal_retain(&copy);
+      return copy;
+    }
+    case CELL_FIXED:
+      return new_int32(cell->payload.fixed / FIXED_ONE);
+    default: {
+      const double value = as_float(cell);
+      if (!(value > -9223372036854775808.0 && value < 9223372036854775808.0)) {
+        error(">INT : out of range");
+        return new_empty();
+      }
+      return new_integer((int64_t)value);
+    }
+  }
+}
+
+static void convert_word(context_t* ctx, cell_t (*convert)(const cell_t*),
+                         const char* name) {
+  if (ctx->data_stack_ptr < 1) {
+    error("%s : stack underflow", name);
+    return;
+  }
+
+  cell_t* top = &ctx->data_stack[ctx->data_stack_ptr - 1];
+  if (!is_number(top)) {
+    error("%s : not a number", name);
+    return;
+  }
+
+  cell_t result = convert(top);
+  metal_release(top);
+  *top = result;
+}
+
+static void native_to_float32(context_t* ctx) {
+  convert_word(ctx, to_float32, ">FLOAT32");
+}
+
+static void native_to_float(context_t* ctx) {
+  convert_word(ctx, to_float, ">FLOAT");
+}
+
+static void native_to_fixed(context_t* ctx) {
+  convert_word(ctx, to_fixed, ">FIXED");
+}
+
+static void native_to_integer(context_t* ctx) {
+  convert_word(ctx, to_integer, ">INT");
+}
+
+// Quickening. Compiled code starts with a learning variant of a generic
+// word. Its first run looks at the operand types and rewrites the
+// instruction in place (ctx->ip - 1) to a variant specialized for them.
+// A specialized variant guards its types and, if they ever change, rewrites
+// the instruction back to the generic word for good.
+
+static void quicken(context_t* ctx, native_func_t variant) {
+  (ctx->ip - 1)->payload.native = variant;
+}
+
+static bool top_two_are(const context_t* ctx, cell_type_t type) {
+  const int sp = ctx->data_stack_ptr;
+  return sp >= 2 && ctx->data_stack[sp - 1].type == type &&
+         ctx->data_stack[sp - 2].type == type;
+}
+
+static void learn(context_t* ctx, native_func_t generic,
+                  native_func_t int32_variant, native_func_t float_variant,
+                  native_func_t float32_variant) {
+  native_func_t variant = generic;
+  if (top_two_are(ctx, CELL_INT32)) {
+    variant = int32_variant;
+  } else if (top_two_are(ctx, CELL_FLOAT)) {
+    variant = float_variant;
+  } else if (top_two_are(ctx, CELL_FLOAT32)) {
+    variant = float32_variant;
+  }
+
+  quicken(ctx, variant);
+  variant(ctx);
+}
+
+#define LEARNER(name)                                           \
+  static void native_##name##_learn(context_t* ctx) {          \
+    learn(ctx, native_##name, native_##name##_int32,            \
+          native_##name##_float, native_##name##_float32);      \
+  }
+
+// Float variants of arithmetic, for the cell type and payload field given
+#define FLOAT_ARITHMETIC(name, suffix, type, field, op)        \
+  static void native_##name##_##suffix(context_t* ctx) {       \
+    if (!top_two_are(ctx, type)) {                              \
+      quicken(ctx, native_##name);                              \
+      native_##name(ctx);                                       \
+      return;                                                   \
+    }                                                           \
+                                                                \
+    cell_t* a = &ctx->data_stack[ctx->data_stack_ptr - 2];      \
+    a->payload.field = a->payload.field op a[1].payload.field;  \
+    ctx->data_stack_ptr--;                                      \
+  }
+
+// An int32 overflow is not a type change: the generic word promotes the
+// result but the instruction stays specialized
+#define QUICKENED_ARITHMETIC(name, op, builtin)                \
+  static void native_##name##_int32(context_t* ctx) {         \
+    if (!top_two_are(ctx, CELL_INT32)) {                       \
+      quicken(ctx, native_##name);                             \
+      native_##name(ctx);                                      \
+      return;                                                  \
+    }                                                          \
+                                                               \
+    cell_t* a = &ctx->data_stack[ctx->data_stack_ptr - 2];     \
+    int32_t result;                                            \
+    if (builtin(a->payload.i32, a[1].payload.i32, &result)) {  \
+      native_##name(ctx);                                      \
+      return;                                                  \
+    }                                                          \
+    a->payload.i32 = result;                                   \
+    ctx->data_stack_ptr--;                                     \
+  }                                                            \
+                                                               \
+  FLOAT_ARITHMETIC(name, float, CELL_FLOAT, f, op)             \
+  FLOAT_ARITHMETIC(name, float32, CELL_FLOAT32, f32, op)       \
+  LEARNER(name)
+
+QUICKENED_ARITHMETIC(add, +, __builtin_add_overflow)
+QUICKENED_ARITHMETIC(subtract, -, __builtin_sub_overflow)
+QUICKENED_ARITHMETIC(multiply, *, __builtin_mul_overflow)
+
+// Comparisons replace the operands with an int32 flag
+#define FLOAT_COMPARISON(name, suffix, type, field, op)        \
+  static void native_##name##_##suffix(context_t* ctx) {       \
+    if (!top_two_are(ctx, type)) {                              \
+      quicken(ctx, native_##name);                              \
+      native_##name(ctx);                                       \
+      return;                                                   \
+    }                                                           \
+                                                                \
+    cell_t* a = &ctx->data_stack[ctx->data_stack_ptr - 2];      \
+    *a = new_flag(a->payload.field op a[1].payload.field);      \
+    ctx->data_stack_ptr--;                                      \
+  }
+
+#define QUICKENED_COMPARISON(name, op)                                \
+  static void native_##name##_int32(context_t* ctx) {                \
+    if (!top_two_are(ctx, CELL_INT32)) {                              \
+      quicken(ctx, native_##name);                                    \
+      native_##name(ctx);                                             \
+      return;                                                         \
+    }                                                                 \
+                                                                      \
+    cell_t* a = &ctx->data_stack[ctx->data_stack_ptr - 2];            \
+    a->payload.i32 = a->payload.i32 op a[1].payload.i32 ? -1 : 0;     \
+    ctx->data_stack_ptr--;                                            \
+  }                                                                   \
+                                                                      \
+  FLOAT_COMPARISON(name, float, CELL_FLOAT, f, op)                    \
+  FLOAT_COMPARISON(name, float32, CELL_FLOAT32, f32, op)              \
+  LEARNER(name)
+
+QUICKENED_COMPARISON(less, <)
+QUICKENED_COMPARISON(greater, >)
+QUICKENED_COMPARISON(equal, ==)
+QUICKENED_COMPARISON(not_equal, !=)
+QUICKENED_COMPARISON(less_equal, <=)
+QUICKENED_COMPARISON(greater_equal, >=)
+
+typedef struct {
+  native_func_t variant;
+  native_func_t generic;
+  const char* name;
+} native_variant_t;
+
+#define VARIANTS(name, word)                                  \
+  {native_##name##_learn, native_##name, word " (learning)"}, \
+      {native_##name##_int32, native_##name, word "int32"},   \
+      {native_##name##_float, native_##name, word "float"},   \
+      {native_##name##_float32, native_##name, word "float32"}
+
+static const native_variant_t native_variants[] = {
+    VARIANTS(add, "+"),         VARIANTS(subtract, "-"),
+    VARIANTS(multiply, "*"),    VARIANTS(less, "<"),
+    VARIANTS(greater, ">"),     VARIANTS(equal, "="),
+    VARIANTS(not_equal, "<>"),  VARIANTS(less_equal, "<="),
+    VARIANTS(greater_equal, ">="),
+};
+
+#define NATIVE_VARIANT_COUNT \
+  (sizeof(native_variants) / sizeof(native_variants[0]))
+
+native_func_t learning_variant(native_func_t generic) {
+  for (size_t i = 0; i < NATIVE_VARIANT_COUNT; i++) {
+    if (native_variants[i].generic == generic &&
+        native_variants[i].variant != generic) {
+      return native_variants[i].variant;  // Learners are listed first
+    }
+  }
+  return generic;
+}
+
+native_func_t generic_variant(native_func_t native) {
+  for (size_t i = 0; i < NATIVE_VARIANT_COUNT; i++) {
+    if (native_variants[i].variant == native) {
+      return native_variants[i].generic;
+    }
+  }
+  return native;
+}
+
+const char* variant_name(native_func_t native) {
+  for (size_t i = 0; i < NATIVE_VARIANT_COUNT; i++) {
+    if (native_variants[i].variant == native) return native_variants[i].name;
+  }
+  return NULL;
+}
+
+// Arithmetic and comparison words
+static const dictionary_entry_t math_entries[] = {
+    NATIVE_WORD("+", native_add, "( a b -- c ) Add two numbers"),
+    NATIVE_WORD("-", native_subtract, "( a b -- c ) Subtract b from a"),
+    NATIVE_WORD("*", native_multiply, "( a b -- c ) Multiply two numbers"),
+    NATIVE_WORD("/", native_divide,
+                "( a b -- c ) Divide a by b (integers truncate)"),
+    NATIVE_WORD("MOD", native_mod,
+                "( a b -- c ) Remainder of a / b, sign of a"),
+    NATIVE_WORD("<", native_less, "( a b -- flag ) True if a < b"),
+    NATIVE_WORD(">", native_greater, "( a b -- flag ) True if a > b"),
+    NATIVE_WORD("=", native_equal, "( a b -- flag ) True if a = b"),
+    NATIVE_WORD("<>", native_not_equal,
+                "( a b -- flag ) True if a differs from b"),
+    NATIVE_WORD("<=", native_less_equal, "( a b -- flag ) True if a <= b"),
+    NATIVE_WORD(">=", native_greater_equal, "( a b -- flag ) True if a >= b"),
+
+    // Conversions
+    NATIVE_WORD(">FLOAT32", native_to_float32,
+                "( n -- f32 ) Convert a number to single precision"),
+    NATIVE_WORD(">FLOAT", native_to_float,
+                "( n -- f ) Convert a number to double precision"),
+    NATIVE_WORD(">FIXED", native_to_fixed,
+                "( n -- q ) Convert a number to Q16.16, saturating"),
+    NATIVE_WORD(">INT", native_to_integer,
+                "( n -- i ) Convert a number to an integer, truncating"),
+};
+const word_table_t math_words = WORD_TABLE(math_entries);
@@ -2,8 +2,10 @@
 
 #include <stdlib.h>
 
-#include "debug.h"
+#include "dictionary.h"
 #include "metal.h"
+#include "output.h"
+#include "trace.h"
 
 #ifdef TARGET_PICO
 #include "pico/mutex.h"
@@ -28,65 +30,170 @@ static pthread_mutex_t memory_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define INIT_MEMORY_MUTEX()  // Already initialized
 #endif
 
+#ifdef MEM_STATS_ENABLED
+// Each block starts with its requested size, ahead of the refcount header,
+// so frees can be counted. Image objects have no size, but are never freed.
+#define SIZE_PREFIX sizeof(size_t)
+
+static mem_stats_t stats;
+
+static size_t block_size(const void* block) { return *(const size_t*)block; }
+
+static void set_block_size(void* block, size_t size) {
+  *(size_t*)block = size;
+}
+
+static void count_live(size_t old_size, size_t new_size) {
+  stats.live_bytes = stats.live_bytes - old_size + new_size;
+  if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+}
+
+static void count_alloc(size_t size) {
+  int size_class = 0;
+  for (size_t limit = 16; size > limit && size_class < MEM_SIZE_CLASSES - 1;
+       limit *= 4) {
+    size_class++;
+  }
+  stats.by_size[size_class]++;
+  stats.allocations++;
+  stats.live_blocks++;
+  count_live(0, size);
+}
+
+static void count_resize(size_t old_size, size_t new_size) {
+  stats.resizes++;
+  count_live(old_size, new_size);
+}
+
+static void count_free(size_t size) {
+  stats.frees++;
+  stats.live_blocks--;
+  stats.live_bytes -= size;
+}
+
+void get_mem_stats(mem_stats_t* copy) {
+  LOCK_MEMORY();
+  *copy = stats;
+  UNLOCK_MEMORY();
+}
+
+void count_cell_alloc(cell_type_t type) {
+  LOCK_MEMORY();
+  stats.by_type[type]++;
+  UNLOCK_MEMORY();
+}
+#else
+#define SIZE_PREFIX 0
+static size_t block_size([[maybe_unused]] const void* block) { return 0; }
+static void set_block_size([[maybe_unused]] void* block,
+                           [[maybe_unused]] size_t size) {}
+static void count_alloc([[maybe_unused]] size_t size) {}
+static void count_resize([[maybe_unused]] size_t old_size,
+                         [[maybe_unused]] size_t new_size) {}
+static void count_free([[maybe_unused]] size_t size) {}
+#endif
+
+// A block's data follows its size (when counted) and refcount header
+static void* block_data(void* block) {
+  return (char*)block + SIZE_PREFIX + sizeof(alloc_header_t);
+}
+
+static void* data_block(void* ptr) {
+  return (char*)ptr - sizeof(alloc_header_t) - SIZE_PREFIX;
+}
+
 // Memory management initialization
 void init_memory(void) { INIT_MEMORY_MUTEX(); }
 
 // Core allocation functions
 void* metal_alloc(size_t size) {
-  debug("Allocating %zu bytes", size);
+  trace(TRACE_ALLOCATE, size);
 
   LOCK_MEMORY();
-  alloc_header_t* header = malloc(sizeof(alloc_header_t) + size);
-
-  if (!header) {
-    error("Out of memory");
+  void* block = malloc(SIZE_PREFIX + sizeof(alloc_header_t) + size);
+  if (!block) {
     UNLOCK_MEMORY();
+    error("Out of memory");
     return NULL;
   }
 
-  header->refcount = 1;
+  set_block_size(block, size);
+  count_alloc(size);
   UNLOCK_MEMORY();
-  return (char*)header + sizeof(alloc_header_t);
+
+  void* data = block_data(block);
+  ((alloc_header_t*)data - 1)->refcount = 1;
+  return data;
 }
 
 void* metal_realloc(void* ptr, size_t new_size) {
-  LOCK_MEMORY();
+  if (!ptr) return metal_alloc(new_size);
 
-  if (!ptr) {
-    // Just allocate new
-    alloc_header_t* header = malloc(sizeof(alloc_header_t) + new_size);
-    if (!header) {
-      error("Out of memory");
-      UNLOCK_MEMORY();
-      return NULL;
-    }
-
-    header->refcount = 1;
+  LOCK_MEMORY();
+  void* old_block = data_block(ptr);
+  const size_t old_size = block_size(old_block);
+  void* new_block =
+      realloc(old_block, SIZE_PREFIX + sizeof(alloc_header_t) + new_size);
+  if (!new_block) {
     UNLOCK_MEMORY();
-    return (char*)header + sizeof(alloc_header_t);
-  }
-
-  alloc_header_t* old_header =
-      (alloc_header_t*)((char*)ptr - sizeof(alloc_header_t));
-  alloc_header_t* new_header =
-      realloc(old_header, sizeof(alloc_header_t) + new_size);
-
-  if (!new_header) {
     error("Out of memory");
-    UNLOCK_MEMORY();
     return NULL;
   }
 
+  set_block_size(new_block, new_size);
+  count_resize(old_size, new_size);
   UNLOCK_MEMORY();
-  return (char*)new_header + sizeof(alloc_header_t);
+  return block_data(new_block);
 }
 
 void metal_free(void* ptr) {
   if (!ptr) return;
 
   LOCK_MEMORY();
-  alloc_header_t* header =
-      (alloc_header_t*)((char*)ptr - sizeof(alloc_header_t));
-  free(header);
+  void* block = data_block(ptr);
+  count_free(block_size(block));
+  free(block);
   UNLOCK_MEMORY();
-}
\ No newline at end of file
+}
+
+#ifdef MEM_STATS_ENABLED
+// MEM-STATS ( -- ) Print the heap counters
+static void native_mem_stats([[maybe_unused]] context_t* ctx) {
+  mem_stats_t now;
+  get_mem_stats(&now);
+
+  output_format("Live: %zu bytes in %zu blocks, peak %zu bytes\n",
+                now.live_bytes, now.live_blocks, now.peak_bytes);
+  output_format("Calls: %llu allocations, %llu resizes, %llu frees\n",
+                (unsigned long long)now.allocations,
+                (unsigned long long)now.resizes, (unsigned long long)now.frees);
+
+  static const char* const size_names[MEM_SIZE_CLASSES] = {
+      "<=16", "<=64", "<=256", "<=1K", "<=4K", "<=16K", "<=64K", ">64K"};
+  output_text("By size:");
+  for (int i = 0; i < MEM_SIZE_CLASSES; i++) {
+    output_format(" %s %llu", size_names[i],
+                  (unsigned long long)now.by_size[i]);
+  }
+
+  static const struct {
+    cell_type_t type;
+    const char* name;
+  } types[] = {{CELL_STRING, "string"}, {CELL_ARRAY, "array"},
+               {CELL_OBJECT, "object"}, {CELL_CODE, "code"},
+               {CELL_BIGINT, "bigint"}};
+  output_text("\nBy type:");
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    output_format(" %s %llu", types[i].name,
+                  (unsigned long long)now.by_type[types[i].type]);
+  }
+  output_char('\n');
+}
+
+// Memory words
+static const dictionary_entry_t memory_entries[] = {
+    NATIVE_WORD("MEM-STATS", native_mem_stats,
+                "( -- ) Show live and peak heap use and allocation counts"),
+};
+const word_table_t memory_words = WORD_TABLE(memory_entries);
+#endif
@@ -0,0 +1,605 @@
+#include "metal2c.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bigint.h"
+#include "code.h"
+#include "compiler.h"
+#include "core.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "metal.h"
+#include "util.h"
+
+#define MAX_TRANSLATED_CODES 256
+#define MAX_TRANSLATED_NATIVES 64
+#define MAX_TRANSLATED_LITERALS 256
+#define MAX_KEPT_NATIVES 256
+
+typedef struct {
+  native_func_t func;
+  const char* symbol;
+} native_symbol_t;
+
+// Primitives that translated code calls directly. Any other native is
+// looked up by name when the translated unit registers its words.
+static const native_symbol_t direct_natives[] = {
+    {native_dup, "native_dup"},
+    {native_drop, "native_drop"},
+    {native_swap, "native_swap"},
+    {native_print, "native_print"},
+    {native_nil, "native_nil"},
+    {native_comma, "native_comma"},
+    {native_length, "native_length"},
+    {native_index, "native_index"},
+    {native_fetch, "native_fetch"},
+    {native_store, "native_store"},
+    {native_add, "native_add"},
+    {native_subtract, "native_subtract"},
+    {native_multiply, "native_multiply"},
+    {native_divide, "native_divide"},
+    {native_mod, "native_mod"},
+    {native_less, "native_less"},
+    {native_greater, "native_greater"},
+    {native_equal, "native_equal"},
+    {native_not_equal, "native_not_equal"},
+    {native_less_equal, "native_less_equal"},
+    {native_greater_equal, "native_greater_equal"},
+};
+
+// Translation state. Each code and native remembers the code that first
+// reached it (ROOT_ENTRY or ROOT_VOCABULARY for roots), for the size
+// report.
+#define ROOT_ENTRY -1
+#define ROOT_VOCABULARY -2
+static const code_data_t* codes[MAX_TRANSLATED_CODES];
+static int code_parents[MAX_TRANSLATED_CODES];
+static int code_count;
+static native_func_t kept_natives[MAX_KEPT_NATIVES];  // Including direct
+static int kept_parents[MAX_KEPT_NATIVES];
+static int kept_count;
+static native_func_t natives[MAX_TRANSLATED_NATIVES];
+static int native_count;
+static const cell_t* literals[MAX_TRANSLATED_LITERALS];  // Strings, bigints
+static int literal_count;
+
+static const char* direct_symbol(native_func_t func) {
+  for (size_t i = 0; i < sizeof(direct_natives) / sizeof(direct_natives[0]);
+       i++) {
+    if (direct_natives[i].func == func) return direct_natives[i].symbol;
+  }
+  return NULL;
+}
+
+static bool is_control_native(native_func_t func) {
+  return func == native_exit || func == native_branch ||
+         func == native_zbranch;
+}
+
+static int find_code(const code_data_t* code) {
+  for (int i = 0; i < code_count; i++) {
+    if (codes[i] == code) return i;
+  }
+  return -1;
+}
+
+static int find_native(native_func_t func) {
+  for (int i = 0; i < native_count; i++) {
+    if (natives[i] == func) return i;
+  }
+  return -1;
+}
+
+static int find_literal(const cell_t* cell) {
+  for (int i = 0; i < literal_count; i++) {
+    if (literals[i] == cell) return i;
+  }
+  return -1;
+}
+
+// Name under which a native can be looked up again at registration time
+static const char* native_name(native_func_t func, int builtin_count) {
+  for (int i = builtin_count - 1; i >= 0; i--) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (entry->definition.type == CELL_NATIVE &&
+        entry->definition.payload.native == func) {
+      return entry->name;
+    }
+  }
+  return NULL;
+}
+
+static bool add_code(const code_data_t* code, int parent) {
+  if (find_code(code) >= 0) return true;
+  if (code_count >= MAX_TRANSLATED_CODES) {
+    fprintf(stderr, "metal2c: too many definitions\n");
+    return false;
+  }
+  code_parents[code_count] = parent;
+  codes[code_count++] = code;
+  return true;
+}
+
+static void keep_native(native_func_t func, int parent) {
+  for (int i = 0; i < kept_count; i++) {
+    if (kept_natives[i] == func) return;
+  }
+  if (kept_count < MAX_KEPT_NATIVES) {
+    kept_parents[kept_count] = parent;
+    kept_natives[kept_count++] = func;
+  }
+}
+
+// Gather everything the translated unit has to declare
+static bool collect(int builtin_count) {
+  // Callees are appended while scanning, so this also picks up definitions
+  // that were later shadowed but are still called by live code
+  for (int c = 0; c < code_count; c++) {
+    const code_data_t* code = codes[c];
+    for (size_t i = 0; i < code->length; i++) {
+      const cell_t* instruction = &code->instructions[i];
+
+      switch (instruction->type) {
+        case CELL_CODE:
+          if (!add_code(instruction->payload.ptr, c)) return false;
+          break;
+        case CELL_NATIVE: {
+          native_func_t func = generic_variant(instruction->payload.native);
+          if (func == native_branch || func == native_zbranch) {
+            i++;  // Skip the offset cell
+            break;
+          }
+          if (!is_control_native(func)) keep_native(func, c);
+          if (!is_control_native(func) && !direct_symbol(func) &&
+              find_native(func) < 0) {
+            if (!native_name(func, builtin_count)) {
+              fprintf(stderr, "metal2c: cannot translate native word\n");
+              return false;
+            }
+            if (native_count >= MAX_TRANSLATED_NATIVES) {
+              fprintf(stderr, "metal2c: too many native words\n");
+              return false;
+            }
+            natives[native_count++] = func;
+          }
+          break;
+        }
+        case CELL_STRING:
+        case CELL_BIGINT:
+          if (literal_count >= MAX_TRANSLATED_LITERALS) {
+            fprintf(stderr, "metal2c: too many literals\n");
+            return false;
+          }
+          literals[literal_count++] = instruction;
+          break;
+        case CELL_INT32:
+        case CELL_INT64:
+        case CELL_FLOAT:
+        case CELL_FLOAT32:
+        case CELL_FIXED:
+          break;
+        default:
+          fprintf(stderr, "metal2c: cannot translate literal of type %d\n",
+                  instruction->type);
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void write_c_string(FILE* out, const char* text) {
+  fputc('"', out);
+  for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      fprintf(out, "\\%c", *p);
+    } else if (*p < 32 || *p >= 127) {
+      fprintf(out, "\\%03o", *p);
+    } else {
+      fputc(*p, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static void write_float(FILE* out, double value) {
+  if (value != value) {
+    fprintf(out, "__builtin_nan(\"\")");
+  } else if (value > DBL_MAX || value < -DBL_MAX) {
+    fprintf(out, value < 0 ? "-__builtin_inf()" : "__builtin_inf()");
+  } else {
+    fprintf(out, "%a", value);  // Hex float round-trips exactly
+  }
+}
+
+static void write_literal(FILE* out, const cell_t* cell) {
+  switch (cell->type) {
+    case CELL_INT32:
+      if (cell->payload.i32 == INT32_MIN) {
+        fprintf(out, "  data_push(ctx, new_int32(INT32_MIN));\n");
+      } else {
+        fprintf(out, "  data_push(ctx, new_int32(%" PRId32 "));\n",
+                cell->payload.i32);
+      }
+      break;
+    case CELL_INT64:
+      if (cell->payload.i64 == INT64_MIN) {
+        fprintf(out, "  data_push(ctx, new_int64(INT64_MIN));\n");
+      } else {
+        fprintf(out, "  data_push(ctx, new_int64(INT64_C(%" PRId64 ")));\n",
+                cell->payload.i64);
+      }
+      break;
+    case CELL_FLOAT:
+      fprintf(out, "  data_push(ctx, new_float(");
+      write_float(out, cell->payload.f);
+      fprintf(out, "));\n");
+      break;
+    case CELL_FLOAT32:
+      // The double literal holds the float32 value exactly
+      fprintf(out, "  data_push(ctx, new_float32((float)");
+      write_float(out, cell->payload.f32);
+      fprintf(out, "));\n");
+      break;
+    case CELL_FIXED:
+      fprintf(out, "  data_push(ctx, new_fixed(%" PRId32 "));\n",
+              cell->payload.fixed);
+      break;
+    default:  // CELL_STRING or CELL_BIGINT
+      fprintf(out, "  data_push(ctx, literal_%d);\n", find_literal(cell));
+      break;
+  }
+}
+
+static void write_function(FILE* out, int index) {
+  const code_data_t* code = codes[index];
+
+  // Branch targets become labels
+  bool* labels = metal_alloc(code->length * sizeof(bool));
+  if (!labels) return;
+  memset(labels, 0, code->length * sizeof(bool));
+  for (size_t i = 0; i + 1 < code->length; i++) {
+    const cell_t* instruction = &code->instructions[i];
+    if (instruction->type == CELL_NATIVE &&
+        (instruction->payload.native == native_branch ||
+         instruction->payload.native == native_zbranch)) {
+      labels[i + 1 + code->instructions[i + 1].payload.i32] = true;
+      i++;
+    }
+  }
+
+  fprintf(out, "\nstatic void word_%d(context_t* ctx) {\n", index);
+
+  for (size_t i = 0; i < code->length; i++) {
+    const cell_t* instruction = &code->instructions[i];
+
+    if (labels[i]) fprintf(out, "L%zu:;\n", i);
+
+    if (instruction->type == CELL_CODE) {
+      fprintf(out, "  word_%d(ctx);\n", find_code(instruction->payload.ptr));
+    } else if (instruction->type != CELL_NATIVE) {
+      write_literal(out, instruction);
+    } else if (instruction->payload.native == native_exit) {
+      // The final EXIT is the end of the function
+      if (i + 1 < code->length) fprintf(out, "  return;\n");
+    } else if (instruction->payload.native == native_branch) {
+      size_t target = i + 1 + code->instructions[i + 1].payload.i32;
+      fprintf(out, "  goto L%zu;\n", target);
+      i++;
+    } else if (instruction->payload.native == native_zbranch) {
+      size_t target = i + 1 + code->instructions[i + 1].payload.i32;
+      fprintf(out, "  if (!pop_flag(ctx)) goto L%zu;\n", target);
+      i++;
+    } else {
+      // Translated code has no instruction pointer to quicken through
+      native_func_t func = generic_variant(instruction->payload.native);
+      const char* symbol = direct_symbol(func);
+      if (symbol) {
+        fprintf(out, "  %s(ctx);\n", symbol);
+      } else {
+        fprintf(out, "  native_%d(ctx);\n", find_native(func));
+      }
+    }
+  }
+
+  fprintf(out, "}\n");
+  metal_free(labels);
+}
+
+static void write_unit(FILE* out, const char* input_path, int builtin_count,
+                       int dictionary_count) {
+  fprintf(out, "// Generated by metal2c from ");
+  write_c_string(out, input_path);
+  fprintf(out,
+          " - do not edit\n\n"
+          "#include <stdint.h>\n\n"
+          "#include \"bigint.h\"\n"
+          "#include \"cell.h\"\n"
+          "#include \"code.h\"\n"
+          "#include \"core.h\"\n"
+          "#include \"dictionary.h\"\n"
+          "#include \"math.h\"\n"
+          "#include \"metal.h\"\n"
+          "#include \"metal2c.h\"\n"
+          "#include \"stack.h\"\n\n");
+
+  for (int i = 0; i < native_count; i++) {
+    fprintf(out, "static native_func_t native_%d;  // %s\n", i,
+            native_name(natives[i], builtin_count));
+  }
+  for (int i = 0; i < literal_count; i++) {
+    fprintf(out, "static cell_t literal_%d;\n", i);
+  }
+  if (native_count || literal_count) fprintf(out, "\n");
+
+  for (int i = 0; i < code_count; i++) {
+    fprintf(out, "static void word_%d(context_t* ctx);\n", i);
+  }
+
+  for (int i = 0; i < code_count; i++) {
+    write_function(out, i);
+  }
+
+  // Register in definition order so redefinitions shadow as they did
+  int word_count = 0;
+  for (int i = builtin_count; i < dictionary_count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (entry->definition.type != CELL_CODE ||
+        find_code(entry->definition.payload.ptr) < 0) {
+      continue;  // Not reached from the entry word
+    }
+
+    if (word_count++ == 0) {
+      fprintf(out,
+              "\nstatic const dictionary_entry_t compiled_entries[] = "
+              "{\n");
+    }
+    const bool plain = entry->wordlist == FORTH_WORDLIST &&
+                       !(entry->flags & WORD_FLAG_VOCABULARY);
+    fprintf(out, plain ? "    NATIVE_WORD(" : "    WORDLIST_WORD(");
+    write_c_string(out, entry->name);
+    fprintf(out, ", word_%d, ", find_code(entry->definition.payload.ptr));
+    write_c_string(out, entry->help);
+    if (!plain) {
+      fprintf(out, ", %s, %d",
+              entry->flags & WORD_FLAG_VOCABULARY ? "WORD_FLAG_VOCABULARY"
+                                                  : "WORD_FLAG_NONE",
+              entry->wordlist);
+    }
+    fprintf(out, "),\n");
+  }
+  if (word_count) {
+    fprintf(out,
+            "};\n"
+            "const word_table_t compiled_words = "
+            "WORD_TABLE(compiled_entries);\n");
+  } else {
+    fprintf(out, "\nconst word_table_t compiled_words = {nullptr, 0};\n");
+  }
+
+  fprintf(out, "\nvoid init_compiled_words(void) {\n");
+  for (int i = 0; i < native_count; i++) {
+    fprintf(out, "  native_%d = find_word(", i);
+    write_c_string(out, native_name(natives[i], builtin_count));
+    fprintf(out, ")->definition.payload.native;\n");
+  }
+  for (int i = 0; i < literal_count; i++) {
+    if (literals[i]->type == CELL_BIGINT) {
+      // Bigints are rebuilt from their decimal digits
+      char* digits = bigint_to_string(literals[i]->payload.ptr);
+      fprintf(out, "  parse_bigint(\"%s\", &literal_%d);\n", digits, i);
+      metal_free(digits);
+      continue;
+    }
+    fprintf(out, "  literal_%d = new_string(", i);
+    write_c_string(out, literals[i]->payload.ptr);
+    fprintf(out, ");\n");
+  }
+  fprintf(out, "}\n");
+}
+
+// Tree shaking
+
+// Dictionary name of a translated code, if it still has one
+static const char* code_name(int index, int builtin_count) {
+  for (int i = get_dictionary_size() - 1; i >= builtin_count; i--) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (entry->definition.type == CELL_CODE &&
+        entry->definition.payload.ptr == codes[index]) {
+      return entry->name;
+    }
+  }
+  return NULL;  // Shadowed, reached through an older caller
+}
+
+static bool is_kept_builtin(const dictionary_entry_t* entry) {
+  if (entry->definition.type != CELL_NATIVE) return false;
+  for (int i = 0; i < kept_count; i++) {
+    if (kept_natives[i] == entry->definition.payload.native) return true;
+  }
+  return false;
+}
+
+// Every word the entry word needs, as a header the build includes
+// through METAL_KEEP_WORDS (see dictionary.h)
+static void write_keep_header(FILE* out, const char* input_path,
+                              const char* entry_word, int builtin_count) {
+  fprintf(out, "// Generated by metal2c from ");
+  write_c_string(out, input_path);
+  fprintf(out, " - do not edit\n\n");
+  fprintf(out,
+          "#ifndef METAL_KEEP_WORDS_H\n"
+          "#define METAL_KEEP_WORDS_H\n\n"
+          "#define METAL_ENTRY_WORD ");
+  write_c_string(out, entry_word);
+  fprintf(out,
+          "\n\n"
+          "// Word tables pass literal names, so this folds to a constant "
+          "in their\n"
+          "// initializers\n"
+          "#define metal_keeps_word(name) \\\n"
+          "  (");
+
+  const char* separator = "";
+  for (int i = 0; i < builtin_count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (!is_kept_builtin(entry)) continue;
+    fprintf(out, "%s__builtin_strcmp(name, ", separator);
+    write_c_string(out, entry->name);
+    fprintf(out, ") == 0");
+    separator = " || \\\n   ";
+  }
+  for (int i = 0; i < code_count; i++) {
+    const char* name = code_name(i, builtin_count);
+    if (!name) continue;
+    fprintf(out, "%s__builtin_strcmp(name, ", separator);
+    write_c_string(out, name);
+    fprintf(out, ") == 0");
+    separator = " || \\\n   ";
+  }
+  fprintf(out, ")\n\n#endif  // METAL_KEEP_WORDS_H\n");
+}
+
+static const char* reached_from(int parent, int builtin_count) {
+  if (parent == ROOT_ENTRY) return "entry";
+  if (parent == ROOT_VOCABULARY) return "vocabulary";
+  const char* name = code_name(parent, builtin_count);
+  return name ? name : "(shadowed)";
+}
+
+// What was kept and what reached it, then what was dropped
+static void report_shaking(const char* entry_word, int builtin_count) {
+  printf("metal2c: words reachable from %s\n", entry_word);
+  printf("  %-16s %-9s %6s  %s\n", "word", "kind", "cells", "reached from");
+
+  for (int i = 0; i < code_count; i++) {
+    const char* name = code_name(i, builtin_count);
+    printf("  %-16s %-9s %6zu  %s\n", name ? name : "(shadowed)",
+           "compiled", codes[i]->length,
+           reached_from(code_parents[i], builtin_count));
+  }
+
+  int kept_builtins = 0;
+  size_t help_bytes = 0;  // Kept words lose their help too
+  for (int i = 0; i < builtin_count; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (entry->help) help_bytes += strlen(entry->help) + 1;
+    if (!is_kept_builtin(entry)) continue;
+
+    for (int k = 0; k < kept_count; k++) {
+      if (kept_natives[k] == entry->definition.payload.native) {
+        printf("  %-16s %-9s %6s  %s\n", entry->name, "native", "-",
+               reached_from(kept_parents[k], builtin_count));
+      }
+    }
+    kept_builtins++;
+  }
+
+  printf("metal2c: dropped %d of %d built-in words and %zu bytes of help "
+         "text\n",
+         builtin_count - kept_builtins, builtin_count, help_bytes);
+}
+
+// app.c -> app_keep.h
+static char* keep_header_path(const char* output_path) {
+  size_t stem = strlen(output_path);
+  if (stem > 2 && strcmp(output_path + stem - 2, ".c") == 0) stem -= 2;
+
+  char* path = metal_alloc(stem + sizeof("_keep.h"));
+  if (path) {
+    memcpy(path, output_path, stem);
+    strcpy(path + stem, "_keep.h");
+  }
+  return path;
+}
+
+int metal2c(const char* input_path, const char* output_path,
+            const char* entry_word) {
+  char* source = read_text_file(input_path);
+  if (!source) {
+    fprintf(stderr, "metal2c: cannot read %s\n", input_path);
+    return 1;
+  }
+
+  // Compile the source with the ordinary interpreter; top-level code runs
+  // now, at translation time
+  const int builtin_count = get_dictionary_size();
+  metal_result_t result = interpret(source);
+  metal_free(source);
+
+  if (result != METAL_OK) return 1;
+  if (is_compiling()) {
+    fprintf(stderr, "metal2c: unterminated definition in %s\n", input_path);
+    return 1;
+  }
+
+  const int dictionary_count = get_dictionary_size();
+  code_count = 0;
+  native_count = 0;
+  literal_count = 0;
+  kept_count = 0;
+  if (entry_word) {
+    // Only what the entry word reaches is translated and registered
+    const dictionary_entry_t* entry = find_word(entry_word);
+    if (!entry || entry->definition.type != CELL_CODE ||
+        get_entry_index(entry) < builtin_count) {
+      fprintf(stderr, "metal2c: %s is not a definition in %s\n", entry_word,
+              input_path);
+      return 1;
+    }
+    add_code(entry->definition.payload.ptr, ROOT_ENTRY);
+
+    // Vocabulary words select their wordlists by number, so all of them
+    // stay to keep the numbers as translated
+    for (int i = builtin_count; i < dictionary_count; i++) {
+      const dictionary_entry_t* vocabulary = get_dictionary_entry(i);
+      if ((vocabulary->flags & WORD_FLAG_VOCABULARY) &&
+          !add_code(vocabulary->definition.payload.ptr, ROOT_VOCABULARY)) {
+        return 1;
+      }
+    }
+  } else {
+    for (int i = builtin_count; i < dictionary_count; i++) {
+      const dictionary_entry_t* entry = get_dictionary_entry(i);
+      if (entry->definition.type == CELL_CODE &&
+          !add_code(entry->definition.payload.ptr, ROOT_ENTRY)) {
+        return 1;
+      }
+    }
+  }
+
+  if (!collect(builtin_count)) return 1;
+
+  FILE* out = fopen(output_path, "w");
+  if (!out) {
+    fprintf(stderr, "metal2c: cannot write %s\n", output_path);
+    return 1;
+  }
+
+  write_unit(out, input_path, builtin_count, dictionary_count);
+  fclose(out);
+
+  printf("metal2c: translated %d definitions to %s\n", code_count,
+         output_path);
+  if (!entry_word) return 0;
+
+  char* header_path = keep_header_path(output_path);
+  FILE* header = header_path ? fopen(header_path, "w") : NULL;
+  if (!header) {
+    fprintf(stderr, "metal2c: cannot write %s\n",
+            header_path ? header_path : output_path);
+    metal_free(header_path);
+    return 1;
+  }
+  write_keep_header(header, input_path, entry_word, builtin_count);
+  fclose(header);
+
+  report_shaking(entry_word, builtin_count);
+  printf("metal2c: build with -DMETAL_KEEP_HEADER=%s\n", header_path);
+  metal_free(header_path);
+  return 0;
+}
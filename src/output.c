@@ -0,0 +1,104 @@
+#include "output.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "console.h"
+#include "dictionary.h"
+#include "memory.h"
+
+#ifdef TARGET_PICO
+#define OUTPUT_BUFFER_SIZE 512
+#else
+#define OUTPUT_BUFFER_SIZE 4096
+#endif
+
+static char buffer[OUTPUT_BUFFER_SIZE];
+static size_t used;
+
+void output_flush(void) {
+  if (used == 0) return;
+  console_write(buffer, used);
+  used = 0;
+}
+
+void output_char(char c) {
+  if (used == OUTPUT_BUFFER_SIZE) output_flush();
+  buffer[used++] = c;
+}
+
+void output_span(const char* text, size_t length) {
+  if (length > OUTPUT_BUFFER_SIZE - used) {
+    output_flush();
+    if (length > OUTPUT_BUFFER_SIZE) {
+      console_write(text, length);
+      return;
+    }
+  }
+  memcpy(buffer + used, text, length);
+  used += length;
+}
+
+void output_text(const char* text) { output_span(text, strlen(text)); }
+
+void output_padded(const char* text, int width) {
+  const size_t length = strlen(text);
+  output_span(text, length);
+  for (int i = (int)length; i < width; i++) output_char(' ');
+}
+
+void output_int(int64_t value) {
+  char digits[20];  // Enough for 2^64
+  int start = sizeof(digits);
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  do {
+    digits[--start] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+
+  if (value < 0) output_char('-');
+  output_span(digits + start, sizeof(digits) - start);
+}
+
+void output_format(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  va_list again;
+  va_copy(again, args);
+
+  // Straight into the buffer when it fits, else after a flush, else on its
+  // own
+  const size_t room = OUTPUT_BUFFER_SIZE - used;
+  const int length = vsnprintf(buffer + used, room, format, args);
+  if (length >= 0 && (size_t)length < room) {
+    used += (size_t)length;
+  } else if (length > 0 && length < OUTPUT_BUFFER_SIZE) {
+    output_flush();
+    used = (size_t)vsnprintf(buffer, OUTPUT_BUFFER_SIZE, format, again);
+  } else if (length > 0) {
+    output_flush();
+    char* text = metal_alloc((size_t)length + 1);
+    if (text) {
+      vsnprintf(text, (size_t)length + 1, format, again);
+      console_write(text, (size_t)length);
+      metal_free(text);
+    } else {
+      // Cut short to what the buffer holds
+      vsnprintf(buffer, OUTPUT_BUFFER_SIZE, format, again);
+      used = OUTPUT_BUFFER_SIZE - 1;
+    }
+  }
+
+  va_end(again);
+  va_end(args);
+}
+
+static void native_flush([[maybe_unused]] context_t* ctx) { output_flush(); }
+
+// Output words
+static const dictionary_entry_t output_entries[] = {
+    NATIVE_WORD("FLUSH", native_flush,
+                "( -- ) Send buffered output to the console now"),
+};
+const word_table_t output_words = WORD_TABLE(output_entries);
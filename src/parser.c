@@ -1,11 +1,18 @@
 #include "parser.h"
 
 #include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "debug.h"
+#include "bigint.h"
+#include "cell.h"
+#include "fixed.h"
 #include "memory.h"
+#include "trace.h"
+
+// Significant digits that always fit a uint64_t mantissa
+#define MANTISSA_DIGITS 19
 
 void skip_whitespace(const char** input_pos) {
   while (**input_pos) {
@@ -60,58 +67,43 @@ static char process_escape_char(const char c) {
   }
 }
 
-// Parse string literal with escape sequence processing
-static bool parse_string_literal(const char** input_pos, char* buffer,
-                                 size_t buffer_size) {
-  const char* pos = *input_pos;
-  // Skip opening quote
-  if (*pos != '"') {
-    return false;
-  }
-  pos++;
-  size_t buf_idx = 0;
+// Scan a string literal, leaving escapes for token_string
+static bool parse_string_literal(const char** input_pos, token_t* token) {
+  const char* pos = *input_pos + 1;  // Skip opening quote
+  token->start = pos;
+  token->escaped = false;
   while (*pos && *pos != '"') {
-    if (buf_idx >= buffer_size - 1) {
-      debug("String literal too long");
-      return false;
-    }
     if (*pos == '\\' && *(pos + 1)) {
-      // Escape sequence
-      pos++;  // Skip backslash
-      buffer[buf_idx++] = process_escape_char(*pos);
-      pos++;
-    } else {
-      // Regular character
-      buffer[buf_idx++] = *pos;
-      pos++;
+      token->escaped = true;
+      pos++;  // Skip backslash so an escaped quote doesn't end the string
     }
+    pos++;
   }
   if (*pos != '"') {
-    debug("Unterminated string literal");
+    trace(TRACE_PARSE_UNTERMINATED);
     return false;
   }
 
-  buffer[buf_idx] = '\0';
+  token->length = pos - token->start;
   *input_pos = pos + 1;  // Skip closing quote
 
-  debug("Parsed string literal: '%s'", buffer);
+  trace(TRACE_PARSE_STRING, token->length);
   return true;
 }
 
-token_type_t parse_next_token(const char** input_pos, char* buffer,
-                              size_t buffer_size) {
+token_type_t parse_next_token(const char** input_pos, token_t* token) {
   skip_whitespace(input_pos);
+  token->type = TOKEN_EOF;
   if (!**input_pos) {
     return TOKEN_EOF;
   }
   // Check for string literal
   if (**input_pos == '"') {
-    if (parse_string_literal(input_pos, buffer, buffer_size)) {
-      return TOKEN_STRING;
-    } else {
-      // String parsing failed - this should probably be an error
-      return TOKEN_EOF;
+    if (parse_string_literal(input_pos, token)) {
+      token->type = TOKEN_STRING;
     }
+    // String parsing failed - this should probably be an error
+    return token->type;
   }
   // Parse regular word
   const char* start = *input_pos;
@@ -124,24 +116,39 @@ token_type_t parse_next_token(const char** input_pos, char* buffer,
     }
     end++;
   }
-  size_t length = end - start;
-  if (length >= buffer_size) {
-    debug("Word too long: %.*s", (int)length, start);
-    return TOKEN_EOF;
-  }
-  if (length == 0) {
+  if (end == start) {
     return TOKEN_EOF;
   }
-  strncpy(buffer, start, length);
-  buffer[length] = '\0';
+  token->type = TOKEN_WORD;
+  token->start = start;
+  token->length = end - start;
+  token->escaped = false;
   *input_pos = end;
-  debug("Parsed word: '%s'", buffer);
+  trace(TRACE_PARSE_WORD, token->length);
   return TOKEN_WORD;
 }
 
+cell_t token_string(const token_t* token) {
+  cell_t cell = new_string_span(token->start, token->length);
+  if (!token->escaped || cell.type != CELL_STRING) return cell;
+
+  // Escapes only shrink the text, so decode in place
+  char* text = cell.payload.ptr;
+  size_t out = 0;
+  for (size_t in = 0; in < token->length; in++) {
+    if (text[in] == '\\' && in + 1 < token->length) {
+      text[out++] = process_escape_char(text[++in]);
+    } else {
+      text[out++] = text[in];
+    }
+  }
+  text[out] = '\0';
+  return cell;
+}
+
 char* parse_until_char(context_t* ctx, char delimiter) {
   if (!ctx->input_pos) {
-    debug("parse_until_char: not in parsing context");
+    trace(TRACE_PARSE_UNTIL_NO_INPUT);
     return NULL;
   }
   const char* start = ctx->input_pos;
@@ -151,14 +158,14 @@ char* parse_until_char(context_t* ctx, char delimiter) {
     end++;
   }
   if (*end != delimiter) {
-    debug("parse_until_char: delimiter '%c' not found", delimiter);
+    trace(TRACE_PARSE_UNTIL_MISSING, delimiter);
     return NULL;
   }
   // Copy content
   size_t length = end - start;
-  char* result = malloc(length + 1);
+  char* result = metal_alloc(length + 1);
   if (!result) {
-    debug("parse_until_char: allocation failed");
+    trace(TRACE_PARSE_UNTIL_NO_MEMORY);
     return NULL;
   }
   strncpy(result, start, length);
@@ -167,7 +174,7 @@ char* parse_until_char(context_t* ctx, char delimiter) {
   // Advance context past delimiter
   ctx->input_pos = end + 1;
 
-  debug("parse_until_char: parsed '%s'", result);
+  trace(TRACE_PARSE_UNTIL, length);
   return result;
 }
 
@@ -183,4 +190,202 @@ void skip_to_end_of_line(const char** input_pos) {
   if (**input_pos == '\n') {
     (*input_pos)++;
   }
-}
\ No newline at end of file
+}
+
+// Number scanning. A single pass splits a token into sign, decimal mantissa
+// and exponent, rejecting anything that is not a number as soon as it sees
+// it, so ordinary words cost one or two character tests. Integers are built
+// directly. Decimals take Clinger's fast path when the mantissa and power of
+// ten are both exact in the target format, which makes the result correctly
+// rounded; anything else falls back to strtod.
+
+static const double double_powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const float float_powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                     1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+#define DOUBLE_EXACT_POWER 22
+#define FLOAT_EXACT_POWER 10
+#define DOUBLE_EXACT_MANTISSA (UINT64_C(1) << 53)
+#define FLOAT_EXACT_MANTISSA (UINT64_C(1) << 24)
+
+typedef struct {
+  bool negative;
+  bool decimal;        // has a fraction or exponent
+  bool truncated;      // more than MANTISSA_DIGITS significant digits
+  uint64_t mantissa;   // leading significant digits
+  int64_t exponent;    // value = mantissa * 10^exponent (when not truncated)
+  size_t length;       // characters before any suffix
+  char suffix;         // 'f', 'q' or '\0'
+} number_scan_t;
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Character at p, or '\0' past the end of the token
+static char peek(const char* p, const char* end) { return p < end ? *p : 0; }
+
+static bool scan_number(const char* token, size_t length,
+                        number_scan_t* scan) {
+  const char* p = token;
+  const char* end = token + length;
+  *scan = (number_scan_t){0};
+
+  if (peek(p, end) == '-' || peek(p, end) == '+') {
+    scan->negative = *p++ == '-';
+  }
+  if (!is_digit(peek(p, end)) && peek(p, end) != '.') return false;
+
+  size_t digits = 0;       // digits seen, integer and fraction
+  size_t significant = 0;  // digits after leading zeros
+  int64_t dropped = 0;     // integer digits past MANTISSA_DIGITS
+
+  for (; is_digit(peek(p, end)); p++, digits++) {
+    if (significant == 0 && *p == '0') continue;
+    if (significant < MANTISSA_DIGITS) {
+      scan->mantissa = scan->mantissa * 10 + (uint64_t)(*p - '0');
+    } else {
+      scan->truncated = true;
+      dropped++;
+    }
+    significant++;
+  }
+
+  if (peek(p, end) == '.') {
+    scan->decimal = true;
+    for (p++; is_digit(peek(p, end)); p++, digits++) {
+      if (significant == 0 && *p == '0') {
+        scan->exponent--;
+        continue;
+      }
+      if (significant < MANTISSA_DIGITS) {
+        scan->mantissa = scan->mantissa * 10 + (uint64_t)(*p - '0');
+        scan->exponent--;
+      } else {
+        scan->truncated = true;
+      }
+      significant++;
+    }
+  }
+  if (digits == 0) return false;
+
+  if (peek(p, end) == 'e' || peek(p, end) == 'E') {
+    scan->decimal = true;
+    p++;
+    bool negative_exponent = false;
+    if (peek(p, end) == '-' || peek(p, end) == '+') {
+      negative_exponent = *p++ == '-';
+    }
+    if (!is_digit(peek(p, end))) return false;
+
+    int64_t exponent = 0;
+    for (; is_digit(peek(p, end)); p++) {
+      // Clamp huge exponents; they over- or underflow either way
+      if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+    }
+    scan->exponent += negative_exponent ? -exponent : exponent;
+  }
+  scan->exponent += dropped;
+  scan->length = (size_t)(p - token);
+
+  const char suffix = (char)tolower((unsigned char)peek(p, end));
+  if (suffix == 'f' || suffix == 'q') {
+    scan->suffix = suffix;
+    p++;
+  }
+  return p == end;
+}
+
+// Terminated copy of the numeric part of a token for the libc and bigint
+// parsers (caller frees)
+static char* numeric_part(const char* token, const number_scan_t* scan) {
+  char* digits = metal_alloc(scan->length + 1);
+  if (!digits) return nullptr;
+  memcpy(digits, token, scan->length);
+  digits[scan->length] = '\0';
+  return digits;
+}
+
+static bool scan_to_double(const char* token, const number_scan_t* scan,
+                           double* result) {
+  const int64_t exponent = scan->exponent;
+  if (!scan->truncated && scan->mantissa <= DOUBLE_EXACT_MANTISSA &&
+      exponent >= -DOUBLE_EXACT_POWER && exponent <= DOUBLE_EXACT_POWER) {
+    double value = (double)scan->mantissa;
+    value = exponent < 0 ? value / double_powers[-exponent]
+                         : value * double_powers[exponent];
+    *result = scan->negative ? -value : value;
+    return true;
+  }
+
+  char* digits = numeric_part(token, scan);
+  if (!digits) return false;
+  *result = strtod(digits, nullptr);
+  metal_free(digits);
+  return true;
+}
+
+static bool scan_to_float(const char* token, const number_scan_t* scan,
+                          float* result) {
+  const int64_t exponent = scan->exponent;
+  if (!scan->truncated && scan->mantissa <= FLOAT_EXACT_MANTISSA &&
+      exponent >= -FLOAT_EXACT_POWER && exponent <= FLOAT_EXACT_POWER) {
+    float value = (float)scan->mantissa;
+    value = exponent < 0 ? value / float_powers[-exponent]
+                         : value * float_powers[exponent];
+    *result = scan->negative ? -value : value;
+    return true;
+  }
+
+  char* digits = numeric_part(token, scan);
+  if (!digits) return false;
+  *result = strtof(digits, nullptr);
+  metal_free(digits);
+  return true;
+}
+
+static bool scan_to_integer(const char* token, const number_scan_t* scan,
+                            cell_t* result) {
+  // The mantissa holds every digit unless truncated; past INT64_MAX (or
+  // its negation) the literal is a bigint
+  const uint64_t limit = (uint64_t)INT64_MAX + (scan->negative ? 1 : 0);
+  if (scan->truncated || scan->mantissa > limit) {
+    char* digits = numeric_part(token, scan);
+    if (!digits) return false;
+    const bool parsed = parse_bigint(digits, result);
+    metal_free(digits);
+    return parsed;
+  }
+
+  const int64_t value = scan->negative ? (int64_t)(0 - scan->mantissa)
+                                       : (int64_t)scan->mantissa;
+  if (value >= INT32_MIN && value <= INT32_MAX) {
+    *result = new_int32((int32_t)value);
+  } else {
+    *result = new_int64(value);
+  }
+  return true;
+}
+
+bool try_parse_number(const char* token, size_t length, cell_t* result) {
+  number_scan_t scan;
+  if (!scan_number(token, length, &scan)) return false;
+
+  if (scan.suffix == 'f') {
+    float value;
+    if (!scan_to_float(token, &scan, &value)) return false;
+    *result = new_float32(value);
+    return true;
+  }
+
+  if (!scan.decimal && !scan.suffix) {
+    return scan_to_integer(token, &scan, result);
+  }
+
+  double value;
+  if (!scan_to_double(token, &scan, &value)) return false;
+  *result = scan.suffix == 'q' ? new_fixed(fixed_from_double(value))
+                               : new_float(value);
+  return true;
+}
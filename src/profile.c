@@ -0,0 +1,256 @@
+#include "profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "output.h"
+#include "timer.h"
+
+bool profile_enabled;
+
+// Counters for one definition. Records stay in order of first call, so
+// frames can refer to them by index while the table grows.
+typedef struct {
+  cell_t definition;  // Holds its code, so no other code can take the key
+  uint64_t calls;
+  uint64_t inclusive_ns;  // Outermost activations, so recursion counts once
+  uint64_t exclusive_ns;
+  uint32_t active;  // Activations on the profile stack
+} profile_record_t;
+
+static profile_record_t* records;
+static uint32_t record_count;
+static uint32_t record_capacity;
+static uint32_t* slots;  // Hash table of record indices plus one
+static uint32_t slot_count;  // Power of two
+
+// Calls that have not returned yet. Calls nested deeper than the stack are
+// counted but not timed.
+#define MAX_PROFILE_DEPTH 256
+typedef struct {
+  uint32_t record;
+  uint64_t start;
+  uint64_t children_ns;
+} profile_frame_t;
+static profile_frame_t frames[MAX_PROFILE_DEPTH];
+static int frame_depth;
+static int untimed_depth;
+
+static uintptr_t definition_key(const cell_t* definition) {
+  return definition->type == CELL_NATIVE
+             ? (uintptr_t)definition->payload.native
+             : (uintptr_t)definition->payload.ptr;
+}
+
+static uint32_t key_slot(uintptr_t key) {
+  return (uint32_t)(((uint64_t)key * UINT64_C(0x9e3779b97f4a7c15)) >> 32) &
+         (slot_count - 1);
+}
+
+static bool grow_slots(void) {
+  const uint32_t grown = slot_count ? slot_count * 2 : 256;
+  uint32_t* table = metal_alloc(grown * sizeof(uint32_t));
+  if (!table) return false;
+  memset(table, 0, grown * sizeof(uint32_t));
+
+  metal_free(slots);
+  slots = table;
+  slot_count = grown;
+  for (uint32_t i = 0; i < record_count; i++) {
+    uint32_t slot = key_slot(definition_key(&records[i].definition));
+    while (slots[slot]) slot = (slot + 1) & (slot_count - 1);
+    slots[slot] = i + 1;
+  }
+  return true;
+}
+
+// Index of the definition's record, adding it on its first call; -1 when
+// out of memory
+static int64_t find_record(cell_t definition) {
+  if ((record_count + 1) * 2 > slot_count && !grow_slots()) return -1;
+
+  const uintptr_t key = definition_key(&definition);
+  uint32_t slot = key_slot(key);
+  for (; slots[slot]; slot = (slot + 1) & (slot_count - 1)) {
+    const profile_record_t* record = &records[slots[slot] - 1];
+    if (record->definition.type == definition.type &&
+        definition_key(&record->definition) == key) {
+      return slots[slot] - 1;
+    }
+  }
+
+  if (record_count == record_capacity) {
+    const uint32_t capacity = record_capacity ? record_capacity * 2 : 64;
+    profile_record_t* grown =
+        metal_realloc(records, capacity * sizeof(profile_record_t));
+    if (!grown) return -1;
+    records = grown;
+    record_capacity = capacity;
+  }
+  profile_record_t* record = &records[record_count];
+  memset(record, 0, sizeof(profile_record_t));
+  record->definition = definition;
+  metal_retain(&record->definition);
+  slots[slot] = ++record_count;
+  return record_count - 1;
+}
+
+static void enter(cell_t definition) {
+  const int64_t index = find_record(definition);
+  if (index < 0 || frame_depth == MAX_PROFILE_DEPTH || untimed_depth) {
+    if (index >= 0) records[index].calls++;
+    untimed_depth++;
+    return;
+  }
+
+  profile_record_t* record = &records[index];
+  record->calls++;
+  record->active++;
+  frames[frame_depth++] =
+      (profile_frame_t){.record = (uint32_t)index, .start = timer_ns()};
+}
+
+void profile_enter_code(code_data_t* code) {
+  cell_t definition = {0};
+  definition.type = CELL_CODE;
+  definition.payload.ptr = code;
+  enter(definition);
+}
+
+void profile_enter_native(native_func_t native) {
+  cell_t definition = {0};
+  definition.type = CELL_NATIVE;
+  definition.payload.native = native;
+  enter(definition);
+}
+
+void profile_exit(void) {
+  const uint64_t now = timer_ns();
+  if (untimed_depth) {
+    untimed_depth--;
+    return;
+  }
+  if (frame_depth == 0) return;  // Called before profiling started
+
+  const profile_frame_t* frame = &frames[--frame_depth];
+  const uint64_t elapsed = now - frame->start;
+  profile_record_t* record = &records[frame->record];
+  record->exclusive_ns += elapsed - frame->children_ns;
+  if (--record->active == 0) record->inclusive_ns += elapsed;
+  if (frame_depth > 0) frames[frame_depth - 1].children_ns += elapsed;
+}
+
+void profile_unwind(void) {
+  while (frame_depth > 0) profile_exit();
+  untimed_depth = 0;
+}
+
+static void reset_profile(void) {
+  for (uint32_t i = 0; i < record_count; i++) {
+    metal_release(&records[i].definition);
+  }
+  metal_free(records);
+  metal_free(slots);
+  records = NULL;
+  slots = NULL;
+  record_count = record_capacity = slot_count = 0;
+  frame_depth = untimed_depth = 0;
+}
+
+// Reporting
+
+typedef struct {
+  const char* name;
+  cell_t definition;  // Natives by their generic variant
+  uint64_t calls;
+  uint64_t inclusive_ns;
+  uint64_t exclusive_ns;
+} profile_row_t;
+
+static int by_exclusive_time(const void* a, const void* b) {
+  const profile_row_t* x = a;
+  const profile_row_t* y = b;
+  if (x->exclusive_ns != y->exclusive_ns) {
+    return x->exclusive_ns < y->exclusive_ns ? 1 : -1;
+  }
+  return x->calls < y->calls ? 1 : x->calls > y->calls ? -1 : 0;
+}
+
+static void native_profile_on([[maybe_unused]] context_t* ctx) {
+  reset_profile();
+  profile_enabled = true;
+}
+
+static void native_profile_off([[maybe_unused]] context_t* ctx) {
+  profile_enabled = false;
+}
+
+// PROFILE-REPORT ( -- ) Print the words profiled so far, the most time
+// spent in the word itself first. Quickened variants of a native count as
+// the native.
+static void native_profile_report([[maybe_unused]] context_t* ctx) {
+  profile_row_t* rows = metal_alloc((record_count + 1) * sizeof(*rows));
+  if (!rows) return;
+
+  uint32_t row_count = 0;
+  uint64_t total_ns = 0;
+  for (uint32_t i = 0; i < record_count; i++) {
+    const profile_record_t* record = &records[i];
+    cell_t definition = record->definition;
+    if (definition.type == CELL_NATIVE) {
+      definition.payload.native = generic_variant(definition.payload.native);
+      if (definition.payload.native == native_profile_off ||
+          definition.payload.native == native_profile_report) {
+        continue;  // Still running, or only just stopped the profile
+      }
+    }
+
+    profile_row_t* row = NULL;
+    for (uint32_t r = 0; r < row_count && !row; r++) {
+      if (rows[r].definition.type == definition.type &&
+          definition_key(&rows[r].definition) ==
+              definition_key(&definition)) {
+        row = &rows[r];
+      }
+    }
+    if (!row) {
+      row = &rows[row_count++];
+      const char* name = find_word_name(&definition);
+      *row = (profile_row_t){.name = name ? name : "(anonymous)",
+                             .definition = definition};
+    }
+    row->calls += record->calls;
+    row->inclusive_ns += record->inclusive_ns;
+    row->exclusive_ns += record->exclusive_ns;
+    total_ns += record->exclusive_ns;
+  }
+  qsort(rows, row_count, sizeof(*rows), by_exclusive_time);
+
+  output_format("%-20s %12s %14s %14s %7s\n", "word", "calls", "inclusive ms",
+                "exclusive ms", "self %");
+  for (uint32_t r = 0; r < row_count; r++) {
+    const profile_row_t* row = &rows[r];
+    output_format("%-20s %12llu %14.3f %14.3f %6.1f%%\n", row->name,
+                  (unsigned long long)row->calls, row->inclusive_ns / 1e6,
+                  row->exclusive_ns / 1e6,
+                  total_ns ? 100.0 * row->exclusive_ns / total_ns : 0.0);
+  }
+  output_format("%u words, %.3f ms profiled\n", row_count, total_ns / 1e6);
+  metal_free(rows);
+}
+
+// Profiler words
+static const dictionary_entry_t profile_entries[] = {
+    NATIVE_WORD("PROFILE-ON", native_profile_on,
+                "( -- ) Clear the profile and start counting calls and time "
+                "per word"),
+    NATIVE_WORD("PROFILE-OFF", native_profile_off,
+                "( -- ) Stop profiling, keeping the results"),
+    NATIVE_WORD("PROFILE-REPORT", native_profile_report,
+                "( -- ) Show calls and time per word, slowest first"),
+};
+const word_table_t profile_words = WORD_TABLE(profile_entries);
@@ -1,12 +1,13 @@
 #include "repl.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "compiler.h"
 #include "dictionary.h"
 #include "line_editor.h"
 #include "metal.h"
+#include "output.h"
 #include "stack.h"
 
 static char input_line[INPUT_BUFFER_SIZE];
@@ -15,7 +16,7 @@ static char input_line[INPUT_BUFFER_SIZE];
 void native_bye(context_t* ctx) {
   (void)ctx;
 
-  printf("Goodbye!\n");
+  output_text("Goodbye!\n");
   exit(0);
 }
 
@@ -27,16 +28,15 @@ void native_quit(context_t* ctx) {
   ctx->data_stack_ptr = 0;
   ctx->return_stack_ptr = 0;
 
-  printf("Restarted.\n");
+  output_text("Restarted.\n");
 }
 
 // Enhanced REPL with line editing and history
 void repl(context_t* ctx) {
   for (;;) {
     // Show appropriate prompt based on compilation state
-    // Note: We'll need to add state tracking to Metal for this to work properly
-    printf("\nok> ");
-    fflush(stdout);
+    output_text(is_compiling() ? "\n... " : "\nok> ");
+    output_flush();
 
     // Get line with enhanced editing
     enhanced_get_line(input_line, INPUT_BUFFER_SIZE);
@@ -57,7 +57,7 @@ void repl(context_t* ctx) {
 
     // Show stack depth if non-empty
     if (!is_data_empty(ctx)) {
-      printf(" <%d>", data_depth(ctx));
+      output_format(" <%d>", data_depth(ctx));
     }
   }
 }
\ No newline at end of file
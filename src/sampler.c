@@ -0,0 +1,314 @@
+#include "sampler.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell.h"
+#include "code.h"
+#include "dictionary.h"
+#include "math.h"
+#include "memory.h"
+#include "output.h"
+#include "parser.h"
+#include "sample_timer.h"
+#include "stack.h"
+
+#define MAX_SAMPLE_HZ 10000
+#ifdef TARGET_PICO
+#define SAMPLE_BUFFER_SLOTS (1 << 12)  // 16 KB
+#else
+#define SAMPLE_BUFFER_SLOTS (1 << 20)  // 8 MB
+#endif
+#define MAX_PATH_LENGTH 256
+
+// Samples follow each other in one buffer: the frame count, the
+// instruction pointer, then the return stack from the bottom up. Nothing
+// is looked at until SAMPLE-SAVE, so the handler only copies pointers.
+typedef union {
+  const cell_t* pointer;
+  size_t count;
+} sample_slot_t;
+
+static sample_slot_t* samples;
+static volatile size_t samples_used;
+static volatile size_t samples_dropped;
+static const context_t* volatile sampled;
+static volatile sig_atomic_t sampling;
+
+static void take_sample(void) {
+  if (!sampling) return;
+  const context_t* ctx = sampled;
+
+  int depth = ctx->return_stack_ptr;
+  if (depth < 0 || depth > RETURN_STACK_SIZE) depth = 0;
+  const size_t used = samples_used;
+  if (used + depth + 2 > SAMPLE_BUFFER_SLOTS) {
+    samples_dropped++;
+    return;
+  }
+
+  sample_slot_t* sample = &samples[used];
+  sample[0].count = (size_t)depth;
+  sample[1].pointer = ctx->ip;
+  for (int i = 0; i < depth; i++) {
+    sample[2 + i].pointer = ctx->return_stack[i].payload.pointer;
+  }
+  samples_used = used + depth + 2;
+}
+
+static void stop_sampling(void) {
+  if (!sampling) return;
+  stop_sample_timer();
+  sampling = 0;
+}
+
+// SAMPLE-ON ( hz -- ) Start sampling the running words hz times per second
+// of CPU time, discarding earlier samples
+static void native_sample_on(context_t* ctx) {
+  cell_t hz = data_pop(ctx);
+  if (hz.type != CELL_INT32 || hz.payload.i32 < 1 ||
+      hz.payload.i32 > MAX_SAMPLE_HZ) {
+    metal_release(&hz);
+    error("SAMPLE-ON : expects a rate from 1 to %d Hz", MAX_SAMPLE_HZ);
+    return;
+  }
+
+  if (!sample_timer_available()) {
+    error("SAMPLE-ON : no profiling timer on this platform");
+    return;
+  }
+
+  stop_sampling();
+  if (!samples) samples = metal_alloc(SAMPLE_BUFFER_SLOTS * sizeof(*samples));
+  if (!samples) return;
+  samples_used = 0;
+  samples_dropped = 0;
+  sampled = ctx;
+
+  sampling = 1;
+  if (!start_sample_timer(hz.payload.i32, take_sample)) {
+    sampling = 0;
+    error("SAMPLE-ON : cannot start the profiling timer");
+  }
+}
+
+static void native_sample_off([[maybe_unused]] context_t* ctx) {
+  stop_sampling();
+}
+
+// Naming. Every code the dictionary still reaches, named after its entry
+// or anonymous, in address order; samples in code that has since been
+// freed are left out.
+
+typedef struct {
+  const code_data_t* code;
+  const char* name;
+} named_code_t;
+
+typedef struct {
+  named_code_t* codes;
+  size_t count;
+  size_t capacity;
+} code_map_t;
+
+static bool add_named_code(code_map_t* map, const code_data_t* code,
+                           const char* name) {
+  for (size_t i = 0; i < map->count; i++) {
+    if (map->codes[i].code == code) {
+      if (name && !map->codes[i].name) map->codes[i].name = name;
+      return false;
+    }
+  }
+  if (map->count == map->capacity) {
+    const size_t capacity = map->capacity ? map->capacity * 2 : 64;
+    named_code_t* grown =
+        metal_realloc(map->codes, capacity * sizeof(named_code_t));
+    if (!grown) return false;
+    map->codes = grown;
+    map->capacity = capacity;
+  }
+  map->codes[map->count++] = (named_code_t){code, name};
+  return true;
+}
+
+static int by_address(const void* a, const void* b) {
+  const uintptr_t x = (uintptr_t)((const named_code_t*)a)->code;
+  const uintptr_t y = (uintptr_t)((const named_code_t*)b)->code;
+  return x < y ? -1 : x > y;
+}
+
+static void map_codes(code_map_t* map) {
+  const int size = get_dictionary_size();
+  for (int i = 0; i < size; i++) {
+    const dictionary_entry_t* entry = get_dictionary_entry(i);
+    if (entry->definition.type == CELL_CODE) {
+      add_named_code(map, entry->definition.payload.ptr, entry->name);
+    }
+  }
+
+  // Quotations and code only reached through other code
+  for (size_t c = 0; c < map->count; c++) {
+    const code_data_t* code = map->codes[c].code;
+    for (size_t i = 0; i < code->length; i++) {
+      if (code->instructions[i].type == CELL_CODE) {
+        add_named_code(map, code->instructions[i].payload.ptr, NULL);
+      }
+    }
+  }
+  qsort(map->codes, map->count, sizeof(named_code_t), by_address);
+}
+
+// The code a pointer is inside of, or NULL
+static const named_code_t* find_code(const code_map_t* map,
+                                     const cell_t* pointer) {
+  size_t low = 0;
+  size_t high = map->count;
+  while (low < high) {
+    const size_t middle = (low + high) / 2;
+    const code_data_t* code = map->codes[middle].code;
+    if (pointer < code->instructions) {
+      high = middle;
+    } else if (pointer >= code->instructions + code->length) {
+      low = middle + 1;
+    } else {
+      return &map->codes[middle];
+    }
+  }
+  return NULL;
+}
+
+static const char* code_label(const named_code_t* named) {
+  return named->name ? named->name : "(anonymous)";
+}
+
+// Appends a frame to a folded stack, cutting it short when the line is full
+static size_t append_frame(char* line, size_t size, size_t length,
+                           const char* name) {
+  length += snprintf(line + length, size - length, "%s%s", length ? ";" : "",
+                     name);
+  return length < size ? length : size - 1;
+}
+
+// One sample as a folded stack, root first, into line. Return addresses
+// name their callers; the instruction pointer names the running code and
+// the native before it. Register VM frames are marked by the start of
+// their code, and the one on top is the running code.
+static size_t fold_sample(const code_map_t* map, const sample_slot_t* sample,
+                          char* line, size_t size) {
+  size_t length = 0;
+  const size_t depth = sample[0].count;
+  bool register_top = false;
+
+  for (size_t i = 0; i < depth; i++) {
+    const cell_t* pointer = sample[2 + i].pointer;
+    const named_code_t* named = find_code(map, pointer);
+    if (!named) continue;  // The outermost call's, or freed code
+    length = append_frame(line, size, length, code_label(named));
+    register_top = pointer == named->code->instructions;
+  }
+
+  const cell_t* ip = sample[1].pointer;
+  const named_code_t* running =
+      depth && !register_top ? find_code(map, ip) : NULL;
+  if (running) {
+    length = append_frame(line, size, length, code_label(running));
+    if (ip > running->code->instructions && ip[-1].type == CELL_NATIVE) {
+      cell_t native = ip[-1];
+      native.payload.native = generic_variant(native.payload.native);
+      const char* name = find_word_name(&native);
+      if (name) length = append_frame(line, size, length, name);
+    }
+  }
+  if (length == 0) length = append_frame(line, size, 0, "(interpreter)");
+  return length;
+}
+
+static int by_text(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Folded stacks with their counts, sorted
+static bool write_folded(FILE* file, size_t used) {
+  code_map_t map = {0};
+  map_codes(&map);
+
+  size_t count = 0;
+  for (size_t at = 0; at < used; at += samples[at].count + 2) count++;
+  char** lines = metal_alloc((count + 1) * sizeof(char*));
+  if (!lines) {
+    metal_free(map.codes);
+    return false;
+  }
+
+  const size_t line_size = (MAX_NAME_LENGTH + 1) * (RETURN_STACK_SIZE + 3);
+  char* line = metal_alloc(line_size);
+  size_t n = 0;
+  for (size_t at = 0; line && at < used; at += samples[at].count + 2) {
+    const size_t length = fold_sample(&map, &samples[at], line, line_size);
+    lines[n] = metal_alloc(length + 1);
+    if (!lines[n]) break;
+    memcpy(lines[n++], line, length + 1);
+  }
+  metal_free(line);
+  metal_free(map.codes);
+  qsort(lines, n, sizeof(char*), by_text);
+
+  bool written = true;
+  for (size_t i = 0; i < n;) {
+    size_t same = i + 1;
+    while (same < n && strcmp(lines[same], lines[i]) == 0) same++;
+    if (fprintf(file, "%s %zu\n", lines[i], same - i) < 0) written = false;
+    i = same;
+  }
+  for (size_t i = 0; i < n; i++) metal_free(lines[i]);
+  metal_free(lines);
+  return written;
+}
+
+// SAMPLE-SAVE ( -- ) Stop sampling and write the samples as folded stacks
+// to the file named next
+static void native_sample_save(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) == TOKEN_EOF) {
+    error("SAMPLE-SAVE : missing file name");
+    return;
+  }
+  if (name.length >= MAX_PATH_LENGTH) {
+    error("SAMPLE-SAVE : file name too long");
+    return;
+  }
+  char path[MAX_PATH_LENGTH];
+  memcpy(path, name.start, name.length);
+  path[name.length] = '\0';
+
+  stop_sampling();
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    error("SAMPLE-SAVE : cannot write %s", path);
+    return;
+  }
+  const bool written = !samples || write_folded(file, samples_used);
+  if (fclose(file) != 0 || !written) {
+    error("SAMPLE-SAVE : cannot write %s", path);
+    return;
+  }
+  if (samples_dropped) {
+    output_format("SAMPLE-SAVE : buffer full, %zu samples dropped\n",
+                  (size_t)samples_dropped);
+  }
+}
+
+// Sampler words
+static const dictionary_entry_t sampler_entries[] = {
+    NATIVE_WORD("SAMPLE-ON", native_sample_on,
+                "( hz -- ) Start sampling running words hz times per CPU "
+                "second"),
+    NATIVE_WORD("SAMPLE-OFF", native_sample_off, "( -- ) Stop sampling"),
+    NATIVE_WORD("SAMPLE-SAVE", native_sample_save,
+                "( -- ) Write the samples as folded stacks to the file "
+                "named next"),
+};
+const word_table_t sampler_words = WORD_TABLE(sampler_entries);
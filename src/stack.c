@@ -1,9 +1,9 @@
 #include "stack.h"
 
-#include <stdio.h>
 #include <string.h>
 
-#include "debug.h"
+#include "output.h"
+#include "trace.h"
 #include "util.h"
 
 // Stack initialization
@@ -22,8 +22,7 @@ void data_push(context_t* ctx, cell_t cell) {
     return;
   }
 
-  debug("Pushing cell type %d to data stack (depth: %d)", cell.type,
-        ctx->data_stack_ptr);
+  trace(TRACE_DATA_PUSH, cell.type, ctx->data_stack_ptr);
 
   // Retain reference if needed
   metal_retain(&cell);
@@ -38,8 +37,7 @@ cell_t data_pop(context_t* ctx) {
   }
 
   cell_t cell = ctx->data_stack[--ctx->data_stack_ptr];
-  debug("Popped cell type %d from data stack (depth now: %d)", cell.type,
-        ctx->data_stack_ptr);
+  trace(TRACE_DATA_POP, cell.type, ctx->data_stack_ptr);
 
   // Note: caller is responsible for the reference now
   return cell;
@@ -65,8 +63,7 @@ void return_push(context_t* ctx, cell_t cell) {
     return;
   }
 
-  debug("Pushing cell type %d to return stack (depth: %d)", cell.type,
-        ctx->return_stack_ptr);
+  trace(TRACE_RETURN_PUSH, cell.type, ctx->return_stack_ptr);
 
   // Retain reference if needed
   metal_retain(&cell);
@@ -81,8 +78,7 @@ cell_t return_pop(context_t* ctx) {
   }
 
   cell_t cell = ctx->return_stack[--ctx->return_stack_ptr];
-  debug("Popped cell type %d from return stack (depth now: %d)", cell.type,
-        ctx->return_stack_ptr);
+  trace(TRACE_RETURN_POP, cell.type, ctx->return_stack_ptr);
 
   // Note: caller is responsible for the reference now
   return cell;
@@ -101,19 +97,23 @@ bool is_return_empty(context_t* ctx) { return ctx->return_stack_ptr == 0; }
 
 // Stack introspection
 void print_data_stack(context_t* ctx) {
-  printf("Data Stack (%d): ", ctx->data_stack_ptr);
+  output_text("Data Stack (");
+  output_int(ctx->data_stack_ptr);
+  output_text("): ");
   for (int i = 0; i < ctx->data_stack_ptr; i++) {
-    if (i > 0) printf(" ");
+    if (i > 0) output_char(' ');
     print_cell(&ctx->data_stack[i]);
   }
-  printf("\n");
+  output_char('\n');
 }
 
 void print_return_stack(context_t* ctx) {
-  printf("Return Stack (%d): ", ctx->return_stack_ptr);
+  output_text("Return Stack (");
+  output_int(ctx->return_stack_ptr);
+  output_text("): ");
   for (int i = 0; i < ctx->return_stack_ptr; i++) {
-    if (i > 0) printf(" ");
+    if (i > 0) output_char(' ');
     print_cell(&ctx->return_stack[i]);
   }
-  printf("\n");
+  output_char('\n');
 }
\ No newline at end of file
@@ -1,17 +1,13 @@
 #include "tools.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "dictionary.h"
 #include "metal.h"
+#include "output.h"
 #include "parser.h"
 #include "stack.h"
 
-// External references to dictionary (defined in main.c)
-extern dictionary_entry_t dictionary[];
-extern int dict_size;
-
 // Stack introspection
 
 static void native_dot_s(context_t* ctx) { print_data_stack(ctx); }
@@ -19,32 +15,37 @@ static void native_dot_s(context_t* ctx) { print_data_stack(ctx); }
 // System control
 
 static void native_bye([[maybe_unused]] context_t* ctx) {
-  printf("Goodbye!\n");
+  output_text("Goodbye!\n");
   exit(0);
 }
 
 // Meta commands
 
 static void native_words([[maybe_unused]] context_t* ctx) {
-  printf("Dictionary (%d words):\n", get_dictionary_size());
+  output_format("Dictionary (%d words):\n", get_dictionary_size());
 
   int words_per_line = 8;  // Adjust for readability
   for (int i = 0; i < get_dictionary_size(); i++) {
-    printf("%-12s",
-           get_dictionary_entry(i)->name);  // Left-aligned, 12 chars wide
+    output_padded(get_dictionary_entry(i)->name, 12);
 
     if ((i + 1) % words_per_line == 0 || i == get_dictionary_size() - 1) {
-      printf("\n");
+      output_char('\n');
     }
   }
 }
 
+static void show_help(const dictionary_entry_t* entry) {
+  output_padded(entry->name, 12);
+  output_char(' ');
+  output_text(entry->help);
+  output_char('\n');
+}
+
 static void show_all_help(void) {
-  printf("Available words with help:\n\n");
+  output_text("Available words with help:\n\n");
 
   for (int i = 0; i < get_dictionary_size(); i++) {
-    dictionary_entry_t* entry = get_dictionary_entry(i);
-    printf("%-12s %s\n", entry->name, entry->help);
+    show_help(get_dictionary_entry(i));
   }
 }
 
@@ -55,17 +56,14 @@ static void native_help(context_t* ctx) {
     return;
   }
   // Try to get next word
-  char word_buffer[256];
-  token_type_t token_type =
-      parse_next_token(&ctx->input_pos, word_buffer, sizeof(word_buffer));
-
-  if (token_type == TOKEN_WORD) {
+  token_t word;
+  if (parse_next_token(&ctx->input_pos, &word) == TOKEN_WORD) {
     // Show help for specific word
-    dictionary_entry_t* entry = find_word(word_buffer);
+    const dictionary_entry_t* entry = find_word_span(word.start, word.length);
     if (entry) {
-      printf("%-12s %s\n", entry->name, entry->help);
+      show_help(entry);
     } else {
-      printf("Word '%s' not found\n", word_buffer);
+      output_format("Word '%.*s' not found\n", (int)word.length, word.start);
     }
   } else {
     // No argument or invalid token, show all words
@@ -73,15 +71,16 @@ static void native_help(context_t* ctx) {
   }
 }
 
-// Register all tool words
-void add_tools_words(void) {
-  // Stack introspection
-  add_native_word(".S", native_dot_s, "( -- ) Show stack contents");
+// Tool words
+static const dictionary_entry_t tools_entries[] = {
+    // Stack introspection
+    NATIVE_WORD(".S", native_dot_s, "( -- ) Show stack contents"),
 
-  // System control
-  add_native_word("BYE", native_bye, "( -- ) Exit Metal");
+    // System control
+    NATIVE_WORD("BYE", native_bye, "( -- ) Exit Metal"),
 
-  // Meta commands
-  add_native_word("WORDS", native_words, "( -- ) List all available words");
-  add_native_word("HELP", native_help, "( -- ) Show help for all words");
-}
\ No newline at end of file
+    // Meta commands
+    NATIVE_WORD("WORDS", native_words, "( -- ) List all available words"),
+    NATIVE_WORD("HELP", native_help, "( -- ) Show help for all words"),
+};
+const word_table_t tools_words = WORD_TABLE(tools_entries);
@@ -0,0 +1,232 @@
+#include "trace.h"
+
+#ifdef DEBUG_ENABLED
+#include <stdio.h>
+#include <string.h>
+
+#include "dictionary.h"
+#include "memory.h"
+#include "output.h"
+#include "parser.h"
+#include "timer.h"
+
+#ifdef TARGET_PICO
+#define TRACE_RING_EVENTS (1u << 9)  // 12 KB
+#else
+#define TRACE_RING_EVENTS (1u << 14)
+#endif
+
+#define TRACE_MAGIC 0x5254544D  // "MTTR"
+#define TRACE_VERSION 1
+#define MAX_PATH_LENGTH 256
+
+// Saved trace: this header, then the events oldest first
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t event_size;
+  uint32_t count;    // Events in the file
+  uint64_t written;  // Events traced, including those the ring dropped
+} trace_file_header_t;
+
+static const char* const trace_formats[TRACE_EVENT_COUNT] = {
+    [TRACE_DATA_PUSH] = "Pushed cell type %u to data stack (depth %u)",
+    [TRACE_DATA_POP] = "Popped cell type %u from data stack (depth now %u)",
+    [TRACE_RETURN_PUSH] = "Pushed cell type %u to return stack (depth %u)",
+    [TRACE_RETURN_POP] =
+        "Popped cell type %u from return stack (depth now %u)",
+    [TRACE_RETAIN] = "Retained cell type %u, refcount now %u",
+    [TRACE_RELEASE] = "Released cell type %u, refcount now %u",
+    [TRACE_ALLOCATE] = "Allocating %u bytes",
+    [TRACE_ARRAY_CREATE] = "Created array data with capacity %u",
+    [TRACE_ARRAY_CREATE_FAIL] =
+        "Failed to allocate array data for capacity %u",
+    [TRACE_ARRAY_RESIZE] = "Resized array data from capacity %u to %u",
+    [TRACE_ARRAY_RESIZE_FAIL] = "Failed to resize array data from %u to %u",
+    [TRACE_BIGINT_CREATE_FAIL] = "Failed to allocate bigint data for %u limbs",
+    [TRACE_CODE_CREATE] = "Created code data with length %u",
+    [TRACE_CODE_CREATE_FAIL] = "Failed to allocate code data for length %u",
+    [TRACE_COMPILE_START] = "Compiling word %u",
+    [TRACE_COMPILE_END] = "Compiled word %u (%u cells)",
+    [TRACE_COMPILE_ABORT] = "Aborted compilation after %u cells",
+    [TRACE_INLINE] = "Inlined word %u (%u cells)",
+    [TRACE_RELINK] = "Relinked word %u (%u cells)",
+    [TRACE_RELINK_DONE] = "Relinked %u definitions after redefining word %u",
+    [TRACE_DICTIONARY_INIT] = "Dictionary initialized with %u built-in words",
+    [TRACE_WORD_ADD] = "Added word %u to dictionary",
+    [TRACE_WORD_FOUND] = "Found word %u in dictionary",
+    [TRACE_WORD_MISSING] = "Word of %u characters not found in dictionary",
+    [TRACE_RECLAIM] = "Reclaimed %u of %u retired objects",
+    [TRACE_IMAGE_LOAD] = "Loaded image (%u bytes)",
+    [TRACE_LOWER] = "Lowered %u cells to %u IR instructions, %u registers",
+    [TRACE_INCLUDE_REPLAY] = "INCLUDE replayed cache",
+    [TRACE_INCLUDE_COMPILE] = "INCLUDE compiled (cached: %u)",
+    [TRACE_PARSE_WORD] = "Parsed word of %u characters",
+    [TRACE_PARSE_STRING] = "Parsed string literal of %u bytes",
+    [TRACE_PARSE_UNTERMINATED] = "Unterminated string literal",
+    [TRACE_PARSE_UNTIL] = "parse_until_char: parsed %u bytes",
+    [TRACE_PARSE_UNTIL_MISSING] = "parse_until_char: delimiter '%c' not found",
+    [TRACE_PARSE_UNTIL_NO_INPUT] = "parse_until_char: not in parsing context",
+    [TRACE_PARSE_UNTIL_NO_MEMORY] = "parse_until_char: allocation failed",
+};
+
+trace_ring_t* trace_ring;
+static trace_ring_t* ring;  // Kept after TRACE-OFF for TRACE-SHOW
+
+void trace_write(trace_id_t id, const uint32_t args[3]) {
+  const uint32_t head =
+      atomic_load_explicit(&trace_ring->head, memory_order_relaxed);
+  trace_event_t* event = &trace_ring->events[head % TRACE_RING_EVENTS];
+  event->time_ns = timer_ns();
+  event->id = id;
+  memcpy(event->args, args, sizeof(event->args));
+  atomic_store_explicit(&trace_ring->head, head + 1, memory_order_release);
+}
+
+// Where the oldest event still in the ring is, and how many there are
+static uint32_t oldest_event(uint32_t written, uint32_t* count) {
+  *count = written < TRACE_RING_EVENTS ? written : TRACE_RING_EVENTS;
+  return (written - *count) % TRACE_RING_EVENTS;
+}
+
+static void print_event(const trace_event_t* event, uint64_t start_ns) {
+  output_format("%12.3f us  ", (event->time_ns - start_ns) / 1e3);
+  if (event->id < TRACE_EVENT_COUNT && trace_formats[event->id]) {
+    output_format(trace_formats[event->id], event->args[0], event->args[1],
+                  event->args[2]);
+  } else {
+    output_format("Unknown event %u", event->id);
+  }
+  output_char('\n');
+}
+
+int decode_trace(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "metal: cannot read %s\n", path);
+    return 2;
+  }
+
+  trace_file_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+      header.event_size != sizeof(trace_event_t)) {
+    fprintf(stderr, "metal: %s: not a trace from this version\n", path);
+    fclose(file);
+    return 2;
+  }
+
+  output_format("%u of %llu events\n", header.count,
+                (unsigned long long)header.written);
+  trace_event_t event;
+  uint64_t start_ns = 0;
+  for (uint32_t i = 0; i < header.count; i++) {
+    if (fread(&event, sizeof(event), 1, file) != 1) {
+      fprintf(stderr, "metal: %s: truncated\n", path);
+      fclose(file);
+      return 2;
+    }
+    if (i == 0) start_ns = event.time_ns;
+    print_event(&event, start_ns);
+  }
+  fclose(file);
+  return 0;
+}
+
+// TRACE-ON ( -- ) Start recording events, dropping earlier ones
+static void native_trace_on([[maybe_unused]] context_t* ctx) {
+  if (!ring) {
+    ring = metal_alloc(sizeof(trace_ring_t) +
+                       TRACE_RING_EVENTS * sizeof(trace_event_t));
+    if (!ring) return;
+  }
+  atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+  trace_ring = ring;
+}
+
+static void native_trace_off([[maybe_unused]] context_t* ctx) {
+  trace_ring = NULL;
+}
+
+// TRACE-SHOW ( -- ) Print the events in the ring, oldest first
+static void native_trace_show([[maybe_unused]] context_t* ctx) {
+  if (!ring) return;
+  trace_ring_t* tracing = trace_ring;
+  trace_ring = NULL;  // Printing is not part of the trace
+
+  const uint32_t written =
+      atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint32_t count;
+  const uint32_t start = oldest_event(written, &count);
+  for (uint32_t i = 0; i < count; i++) {
+    print_event(&ring->events[(start + i) % TRACE_RING_EVENTS],
+                ring->events[start].time_ns);
+  }
+  output_format("%u of %u events\n", count, written);
+  trace_ring = tracing;
+}
+
+// TRACE-SAVE ( -- ) Write the events in the ring to the file named next,
+// for metal --trace
+static void native_trace_save(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) == TOKEN_EOF) {
+    error("TRACE-SAVE : missing file name");
+    return;
+  }
+  if (name.length >= MAX_PATH_LENGTH) {
+    error("TRACE-SAVE : file name too long");
+    return;
+  }
+  char path[MAX_PATH_LENGTH];
+  memcpy(path, name.start, name.length);
+  path[name.length] = '\0';
+  if (!ring) {
+    error("TRACE-SAVE : nothing traced");
+    return;
+  }
+
+  const uint32_t written =
+      atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint32_t count;
+  const uint32_t start = oldest_event(written, &count);
+  const trace_file_header_t header = {.magic = TRACE_MAGIC,
+                                      .version = TRACE_VERSION,
+                                      .event_size = sizeof(trace_event_t),
+                                      .count = count,
+                                      .written = written};
+
+  // The ring wraps at most once, so the events are in two runs
+  const uint32_t before_wrap =
+      count < TRACE_RING_EVENTS - start ? count : TRACE_RING_EVENTS - start;
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    error("TRACE-SAVE : cannot write %s", path);
+    return;
+  }
+  bool written_ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  written_ok = written_ok && fwrite(&ring->events[start], sizeof(trace_event_t),
+                                    before_wrap, file) == before_wrap;
+  written_ok = written_ok && fwrite(ring->events, sizeof(trace_event_t),
+                                    count - before_wrap,
+                                    file) == count - before_wrap;
+  if (fclose(file) != 0 || !written_ok) {
+    error("TRACE-SAVE : cannot write %s", path);
+  }
+}
+
+// Trace words
+static const dictionary_entry_t trace_entries[] = {
+    NATIVE_WORD("TRACE-ON", native_trace_on,
+                "( -- ) Start recording trace events, dropping earlier ones"),
+    NATIVE_WORD("TRACE-OFF", native_trace_off,
+                "( -- ) Stop recording, keeping the events"),
+    NATIVE_WORD("TRACE-SHOW", native_trace_show,
+                "( -- ) Show the recorded events, oldest first"),
+    NATIVE_WORD("TRACE-SAVE", native_trace_save,
+                "( -- ) Write the recorded events to the file named next"),
+};
+const word_table_t trace_words = WORD_TABLE(trace_entries);
+
+#endif
@@ -3,51 +3,72 @@
 #include <ctype.h>
 #include <stdio.h>
 
+#include "bigint.h"
+#include "fixed.h"
+#include "memory.h"
+#include "output.h"
+
 void print_cell(const cell_t* cell) {
   if (!cell) {
-    printf("<null>");
+    output_text("<null>");
     return;
   }
 
   switch (cell->type) {
     case CELL_INT32:
-      printf("%d", cell->payload.i32);
+      output_int(cell->payload.i32);
       break;
     case CELL_INT64:
-      printf("%lld", (long long)cell->payload.i64);
+      output_int(cell->payload.i64);
       break;
     case CELL_FLOAT:
-      printf("%g", cell->payload.f);
+      output_format("%g", cell->payload.f);
+      break;
+    case CELL_FLOAT32:
+      output_format("%gf", (double)cell->payload.f32);
+      break;
+    case CELL_FIXED:
+      output_format("%.10gq", fixed_to_double(cell->payload.fixed));
+      break;
+    case CELL_BIGINT: {
+      char* digits = bigint_to_string(cell->payload.ptr);
+      if (digits) {
+        output_text(digits);
+        metal_free(digits);
+      }
       break;
+    }
     case CELL_STRING:
-      printf("\"%s\"", (char*)cell->payload.ptr);
+      output_char('"');
+      output_text(cell->payload.ptr);
+      output_char('"');
       break;
     case CELL_NIL:
-      printf("[]");
+      output_text("[]");
       break;
     case CELL_ARRAY: {
       const array_data_t* data = (array_data_t*)cell->payload.ptr;
 
-      printf("[");
+      output_char('[');
 
       for (size_t i = 0; i < data->length; i++) {
-        if (i > 0) printf(", ");
+        if (i > 0) output_text(", ");
         print_cell(&data->elements[i]);
       }
 
-      printf("]");
+      output_char(']');
       break;
     }
     case CELL_POINTER:
-      printf("<pointer: ");
+      output_text("<pointer: ");
       print_cell(cell->payload.pointer);
-      printf(">");
+      output_char('>');
       break;
     case CELL_EMPTY:
-      printf("<empty>");
+      output_text("<empty>");
       break;
     default:
-      printf("<type %d>", cell->type);
+      output_format("<type %d>", cell->type);
       break;
   }
 }
@@ -65,3 +86,33 @@ int stricmp(const char* s1, const char* s2) {
 
   return tolower((unsigned char)*s1) - tolower((unsigned char)*s2);
 }
+
+uint64_t fnv1a(const void* data, size_t length, uint64_t hash) {
+  const unsigned char* bytes = data;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+// Read a whole file into a NUL-terminated buffer (release with metal_free)
+char* read_text_file(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return NULL;
+
+  char* text = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+      text = metal_alloc((size_t)size + 1);
+      if (text) {
+        size_t read = fread(text, 1, (size_t)size, file);
+        text[read] = '\0';
+      }
+    }
+  }
+
+  fclose(file);
+  return text;
+}
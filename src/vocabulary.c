@@ -0,0 +1,153 @@
+#include "vocabulary.h"
+
+#include <string.h>
+
+#include "cell.h"
+#include "code.h"
+#include "dictionary.h"
+#include "memory.h"
+#include "output.h"
+#include "parser.h"
+#include "stack.h"
+
+// The search order always holds at least one wordlist. FORTH is searched
+// after it regardless (see dictionary.h), so replacing FORTH with an empty
+// wordlist still leaves ONLY and FORTH to get back with.
+static void replace_first(int wordlist) {
+  int order[MAX_SEARCH_ORDER];
+  const int depth = get_search_order(order);
+  order[0] = wordlist;
+  set_search_order(order, depth);
+}
+
+// (VOCABULARY) ( wordlist -- ) Body of every vocabulary word
+static void native_select_vocabulary(context_t* ctx) {
+  cell_t wordlist = data_pop(ctx);
+  if (wordlist.type != CELL_INT32 || wordlist.payload.i32 < 0 ||
+      wordlist.payload.i32 >= get_wordlist_count()) {
+    metal_release(&wordlist);
+    error("(VOCABULARY) : no such wordlist");
+    return;
+  }
+  replace_first(wordlist.payload.i32);
+}
+
+// VOCABULARY ( -- ) Define the word named next, which selects a new
+// wordlist
+static void native_vocabulary(context_t* ctx) {
+  token_t name;
+  if (!ctx->input_pos ||
+      parse_next_token(&ctx->input_pos, &name) != TOKEN_WORD) {
+    error("VOCABULARY : missing name");
+    return;
+  }
+  if (name.length > MAX_NAME_LENGTH) {
+    error("VOCABULARY : name too long: %.*s", (int)name.length, name.start);
+    return;
+  }
+  const int wordlist = get_wordlist_count();
+  if (wordlist >= MAX_WORDLISTS) {
+    error("VOCABULARY : too many wordlists");
+    return;
+  }
+
+  code_data_t* code = create_code_data(3);
+  if (!code) {
+    error("Out of memory");
+    return;
+  }
+  code->instructions[0] = new_int32(wordlist);
+  code->instructions[1].type = CELL_NATIVE;
+  code->instructions[1].payload.native = native_select_vocabulary;
+  code->instructions[2].type = CELL_NATIVE;
+  code->instructions[2].payload.native = native_exit;
+
+  char text[MAX_NAME_LENGTH + 1];
+  memcpy(text, name.start, name.length);
+  text[name.length] = '\0';
+  add_code_word(text, new_code(code),
+                "( -- ) Search this vocabulary first, in place of the first "
+                "wordlist of the search order");
+
+  // Flagged only once its wordlist exists, since forgetting a vocabulary
+  // word drops the newest wordlist
+  const int index = get_dictionary_size() - 1;
+  if (create_wordlist(index) != wordlist) {
+    forget_words(index);
+    error("VOCABULARY : cannot create wordlist");
+    return;
+  }
+  get_defined_entry(index)->flags |= WORD_FLAG_VOCABULARY;
+}
+
+static void native_also([[maybe_unused]] context_t* ctx) {
+  int order[MAX_SEARCH_ORDER + 1];
+  const int depth = get_search_order(order + 1);
+  if (depth >= MAX_SEARCH_ORDER) {
+    error("ALSO : search order full");
+    return;
+  }
+  order[0] = order[1];
+  set_search_order(order, depth + 1);
+}
+
+static void native_only([[maybe_unused]] context_t* ctx) {
+  const int order[] = {FORTH_WORDLIST};
+  set_search_order(order, 1);
+}
+
+static void native_previous([[maybe_unused]] context_t* ctx) {
+  int order[MAX_SEARCH_ORDER];
+  const int depth = get_search_order(order);
+  if (depth <= 1) {
+    error("PREVIOUS : search order would be empty");
+    return;
+  }
+  set_search_order(order + 1, depth - 1);
+}
+
+static void native_forth([[maybe_unused]] context_t* ctx) {
+  replace_first(FORTH_WORDLIST);
+}
+
+static void native_definitions([[maybe_unused]] context_t* ctx) {
+  int order[MAX_SEARCH_ORDER];
+  get_search_order(order);
+  set_current_wordlist(order[0]);
+}
+
+static void native_order([[maybe_unused]] context_t* ctx) {
+  int order[MAX_SEARCH_ORDER];
+  const int depth = get_search_order(order);
+  bool searches_forth = false;
+  output_text("Search order:");
+  for (int i = 0; i < depth; i++) {
+    output_format(" %s", get_wordlist_name(order[i]));
+    searches_forth |= order[i] == FORTH_WORDLIST;
+  }
+  if (!searches_forth) output_text(" (then FORTH)");
+  output_format("\nDefinitions: %s\n",
+                get_wordlist_name(get_current_wordlist()));
+}
+
+// Vocabulary words
+static const dictionary_entry_t vocabulary_entries[] = {
+    NATIVE_WORD("VOCABULARY", native_vocabulary,
+                "( -- ) Define the word named next as a new vocabulary"),
+    NATIVE_WORD("(VOCABULARY)", native_select_vocabulary,
+                "( wordlist -- ) Search a wordlist first (run by vocabulary "
+                "words)"),
+    NATIVE_WORD("ALSO", native_also,
+                "( -- ) Duplicate the first wordlist of the search order"),
+    NATIVE_WORD("ONLY", native_only,
+                "( -- ) Search only the FORTH wordlist"),
+    NATIVE_WORD("PREVIOUS", native_previous,
+                "( -- ) Drop the first wordlist of the search order"),
+    NATIVE_WORD("FORTH", native_forth,
+                "( -- ) Search the built-in words first"),
+    NATIVE_WORD("DEFINITIONS", native_definitions,
+                "( -- ) Define new words into the first wordlist searched"),
+    NATIVE_WORD("ORDER", native_order,
+                "( -- ) Show the search order and the current wordlist"),
+};
+const word_table_t vocabulary_words = WORD_TABLE(vocabulary_entries);